@@ -0,0 +1,267 @@
+/*
+This file holds the source code for the persistent configuration store
+The configuration is loaded from NVS once at boot into a RAM cache
+Runtime updates are written to a spare copy and published with a pointer swap
+so readers (the control loop) never block and never see a half written struct
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+#include "config.h"
+#include "servo.h"
+#include "gps.h"
+#include "control.h"
+#include "wifi_sta.h"
+#include "time_sync.h"
+#include "failsafe.h"
+#include "tcp_client.h"
+#include "power.h"
+#include "ota.h"
+#include "functions.h"
+
+
+// Global to this file
+// config_active always points at one of config_slots. Writers never touch the
+// slot it points at. Readers must call Config_Get once per iteration and not
+// hold the pointer across blocking calls
+static laelaps_config_t config_slots[CFG_NUM_SLOTS];
+static _Atomic(const laelaps_config_t *) config_active = NULL;
+static uint8_t config_active_slot = 0;
+static int64_t config_retired_us[CFG_NUM_SLOTS];   // When each slot was last replaced
+static SemaphoreHandle_t config_write_mutex = NULL;
+static StaticSemaphore_t config_write_mutex_buf;
+static const char* CFG_TAG = "Config";
+
+
+// Config_Load_Defaults
+// Fills a config struct with the compile time defaults
+// Takes pointer to struct to fill. Does not return anything
+void Config_Load_Defaults(laelaps_config_t *cfg){
+    uint8_t i;
+    memset(cfg, 0, sizeof(laelaps_config_t));
+    cfg->schema_version = CFG_SCHEMA_VERSION;
+
+    strncpy(cfg->wifi_ssid, ESP_WIFI_SSID, CFG_SSID_MAX_LEN);
+    strncpy(cfg->wifi_pass, ESP_WIFI_PASS, CFG_PASS_MAX_LEN);
+    cfg->wifi_max_retry = ESP_MAXIMUM_RETRY;
+
+    cfg->gps_baud = GPS_UART_BAUD;
+    cfg->gps_pps_pin = TIME_PPS_PIN;
+
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        cfg->servo[i].pin = CFG_SERVO_UNUSED;
+        cfg->servo[i].protocol = SERVO_PROTO_PWM50;
+        cfg->servo[i].min_deg = SERVO_MIN_DEG;
+        cfg->servo[i].max_deg = SERVO_MAX_DEG;
+        cfg->servo[i].min_us = SERVO_MIN_US;
+        cfg->servo[i].max_us = SERVO_MAX_US;
+    }
+    cfg->servo[0].pin = SERVO_1_PIN;
+    cfg->servo[1].pin = SERVO_2_PIN;
+
+    cfg->control_period_us = CONTROL_PERIOD_US;
+    cfg->control_step_deg = CONTROL_STEP_DEG;
+    cfg->control_jitter_budget_us = POWER_JITTER_BUDGET_US;
+    cfg->control_record = CONTROL_RECORD;
+
+    // No fences by default, memset left every fence with 0 vertices
+    cfg->failsafe_enable = FAILSAFE_ALL;
+    cfg->failsafe_action = FAILSAFE_ACT_CENTER;
+    cfg->failsafe_min_sats = FAILSAFE_MIN_SATS;
+    cfg->failsafe_fix_timeout_ms = FAILSAFE_FIX_TIMEOUT_MS;
+    cfg->failsafe_link_timeout_ms = FAILSAFE_LINK_TIMEOUT_MS;
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        cfg->failsafe_pos[i] = (SERVO_MIN_DEG + SERVO_MAX_DEG) / 2;
+    }
+
+    strncpy(cfg->tlm_host, TCP_SERVER_HOST, CFG_HOST_MAX_LEN);
+    cfg->tlm_port = TCP_SERVER_PORT;
+    cfg->ota_port = OTA_PORT;
+
+    cfg->unit_id = TCP_UNIT_ID;
+    cfg->fleet_num_slots = TCP_FLEET_NUM_SLOTS;
+    cfg->fleet_slot = TCP_FLEET_SLOT;
+    cfg->fleet_frame_ms = TCP_FLEET_FRAME_MS;
+
+    cfg->pm_enable = POWER_PM_ENABLE;
+    cfg->pm_light_sleep = POWER_LIGHT_SLEEP;
+    cfg->pm_max_mhz = POWER_MAX_MHZ;
+    cfg->pm_min_mhz = POWER_MIN_MHZ;
+    cfg->wifi_ps = POWER_WIFI_PS;
+    cfg->tlm_batch_ms = POWER_TLM_BATCH_MS;
+}
+
+
+// Config_Validate
+// Checks a config struct for values that would break the system
+// Returns ESP_OK if good, ESP_ERR_INVALID_ARG otherwise
+esp_err_t Config_Validate(const laelaps_config_t *cfg){
+    uint8_t i;
+    if(cfg->schema_version != CFG_SCHEMA_VERSION) return ESP_ERR_INVALID_ARG;
+    if(cfg->wifi_ssid[CFG_SSID_MAX_LEN] != '\0') return ESP_ERR_INVALID_ARG;
+    if(cfg->wifi_pass[CFG_PASS_MAX_LEN] != '\0') return ESP_ERR_INVALID_ARG;
+    if(cfg->gps_baud == 0) return ESP_ERR_INVALID_ARG;
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        if(cfg->servo[i].min_deg >= cfg->servo[i].max_deg) return ESP_ERR_INVALID_ARG;
+        if(cfg->servo[i].min_us >= cfg->servo[i].max_us) return ESP_ERR_INVALID_ARG;
+        if(cfg->servo[i].protocol >= SERVO_NUM_PROTOS) return ESP_ERR_INVALID_ARG;
+        if(Servo_Is_DShot(cfg->servo[i].protocol)) continue;
+        if(cfg->servo[i].max_us >= Servo_Period_Ticks(cfg->servo[i].protocol)) return ESP_ERR_INVALID_ARG;
+    }
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        if(cfg->failsafe_pos[i] < cfg->servo[i].min_deg) return ESP_ERR_INVALID_ARG;
+        if(cfg->failsafe_pos[i] > cfg->servo[i].max_deg) return ESP_ERR_INVALID_ARG;
+    }
+    for(i = 0; i < CFG_NUM_FENCES; i++){
+        if(cfg->fence[i].type > FENCE_KEEP_OUT) return ESP_ERR_INVALID_ARG;
+        if(cfg->fence[i].num_vertices > CFG_FENCE_MAX_VERTICES) return ESP_ERR_INVALID_ARG;
+    }
+    if(cfg->failsafe_action > FAILSAFE_ACT_PRESET) return ESP_ERR_INVALID_ARG;
+    if(cfg->control_period_us < CONTROL_PERIOD_MIN_US) return ESP_ERR_INVALID_ARG;
+    if(cfg->control_period_us > CONTROL_PERIOD_MAX_US) return ESP_ERR_INVALID_ARG;
+    if(cfg->control_record > 1) return ESP_ERR_INVALID_ARG;
+    if(cfg->tlm_host[CFG_HOST_MAX_LEN] != '\0') return ESP_ERR_INVALID_ARG;
+    if(cfg->tlm_port == 0) return ESP_ERR_INVALID_ARG;
+    if((cfg->ota_port != 0) && (cfg->ota_port == cfg->tlm_port)) return ESP_ERR_INVALID_ARG;
+    if((cfg->fleet_num_slots > 1) && (cfg->fleet_slot >= cfg->fleet_num_slots)) return ESP_ERR_INVALID_ARG;
+    if((cfg->fleet_frame_ms == 0) || (cfg->fleet_frame_ms > TCP_FLEET_FRAME_MAX_MS)) return ESP_ERR_INVALID_ARG;
+    if((TIME_US_PER_DAY / 1000) % cfg->fleet_frame_ms) return ESP_ERR_INVALID_ARG;      // Slots would shift at midnight
+    if(cfg->fleet_frame_ms < cfg->fleet_num_slots) return ESP_ERR_INVALID_ARG;   // Slots shorter than 1 ms
+    if((cfg->pm_min_mhz == 0) || (cfg->pm_min_mhz > cfg->pm_max_mhz)) return ESP_ERR_INVALID_ARG;
+    if(cfg->wifi_ps > WIFI_PS_MAX_MODEM) return ESP_ERR_INVALID_ARG;
+    if(cfg->tlm_batch_ms > POWER_TLM_BATCH_MAX_MS) return ESP_ERR_INVALID_ARG;
+    // Wi-Fi without modem sleep holds the chip awake, light sleep would never happen
+    if(cfg->pm_light_sleep && (cfg->wifi_ps == WIFI_PS_NONE)) return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+
+// Config_Init
+// Loads the configuration from NVS into the RAM cache
+// Falls back to defaults if nothing is stored or the stored blob is stale
+// Must be called after nvs_flash_init and before any other Init_ function
+void Config_Init(void){
+    laelaps_config_t *cfg = &config_slots[0];
+    nvs_handle_t nvs;
+    size_t blob_len = sizeof(laelaps_config_t);
+    esp_err_t err;
+
+    config_write_mutex = xSemaphoreCreateMutexStatic(&config_write_mutex_buf);
+    configASSERT(config_write_mutex);
+
+    err = nvs_open(CFG_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if(err == ESP_OK){
+        err = nvs_get_blob(nvs, CFG_NVS_KEY, cfg, &blob_len);
+        nvs_close(nvs);
+    }
+
+    if((err != ESP_OK) || (blob_len != sizeof(laelaps_config_t)) || (Config_Validate(cfg) != ESP_OK)){
+        ESP_LOGW(CFG_TAG, "No valid stored config (%s), using defaults", esp_err_to_name(err));
+        Config_Load_Defaults(cfg);
+    }
+    else{
+        ESP_LOGI(CFG_TAG, "Loaded config from NVS");
+    }
+
+    cfg->version = 1;
+    Failsafe_Build_Fences(cfg, 0);
+    config_active_slot = 0;
+    atomic_store_explicit(&config_active, cfg, memory_order_release);
+}
+
+
+// Config_Get
+// Returns a pointer to the active configuration. Never blocks
+// The pointed to struct is never modified while it is active. It may be
+// refilled once replaced, so do not keep the pointer across a blocking call
+const laelaps_config_t* Config_Get(void){
+    return atomic_load_explicit(&config_active, memory_order_acquire);
+}
+
+
+// Config_Update
+// Validates and publishes a new configuration. Optionally stores it in NVS
+// Must not be called from the control loop, it may block on the write mutex, flash,
+// or until the slot it fills is out of use. Beats for health_id while it waits
+// Returns ESP_OK on success, or the validation / NVS error
+esp_err_t Config_Update(const laelaps_config_t *new_cfg, uint8_t persist, int8_t health_id){
+    laelaps_config_t *slot;
+    uint8_t slot_idx;
+    uint32_t version;
+    int64_t ready_us;
+    int64_t wait_us;
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    err = Config_Validate(new_cfg);
+    if(err != ESP_OK){
+        ESP_LOGW(CFG_TAG, "Rejected invalid config");
+        return err;
+    }
+
+    xSemaphoreTake(config_write_mutex, portMAX_DELAY);
+
+    // Fill the slot after the active one. With three slots a reader that
+    // loaded the previous pointer still has a full update cycle before reuse
+    version = Config_Get()->version + 1;
+    slot_idx = (config_active_slot + 1) % CFG_NUM_SLOTS;
+    slot = &config_slots[slot_idx];
+
+    // Two updates in quick succession would reach it while a reader that loaded
+    // it just before it was replaced is still in its iteration, so wait that out
+    ready_us = config_retired_us[slot_idx] + slot->control_period_us + CFG_GRACE_MS * 1000;
+    wait_us = ready_us - esp_timer_get_time();
+    if(wait_us > 0){
+        ESP_LOGI(CFG_TAG, "Update %lu waits %lld us for readers", (unsigned long) version, (long long) wait_us);
+    }
+    while((wait_us = ready_us - esp_timer_get_time()) > 0){
+        if(wait_us > CFG_WAIT_SLICE_MS * 1000) wait_us = CFG_WAIT_SLICE_MS * 1000;
+        vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000) + 1);
+        Health_Beat(health_id);
+    }
+    memcpy(slot, new_cfg, sizeof(laelaps_config_t));
+    slot->version = version;
+
+    // Fence grids are rebuilt here rather than in the control loop, into
+    // the fence slot of the same index so they are retired together
+    Failsafe_Build_Fences(slot, slot_idx);
+
+    // Publish
+    atomic_store_explicit(&config_active, slot, memory_order_release);
+    config_retired_us[config_active_slot] = esp_timer_get_time();
+    config_active_slot = slot_idx;
+
+    if(persist){
+        err = nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+        if(err == ESP_OK){
+            err = nvs_set_blob(nvs, CFG_NVS_KEY, slot, sizeof(laelaps_config_t));
+            if(err == ESP_OK) err = nvs_commit(nvs);
+            nvs_close(nvs);
+        }
+        if(err != ESP_OK){
+            ESP_LOGE(CFG_TAG, "Failed to store config: %s", esp_err_to_name(err));
+        }
+    }
+
+    xSemaphoreGive(config_write_mutex);
+
+    ESP_LOGI(CFG_TAG, "Config version %lu active", (unsigned long) version);
+    return err;
+}
@@ -0,0 +1,122 @@
+/*
+This file holds the macro definitions and types for config.c
+The configuration is stored in NVS as one blob and cached in RAM
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+// NVS location of the stored configuration
+#define CFG_NVS_NAMESPACE   "laelaps"
+#define CFG_NVS_KEY         "cfg"
+
+// Bump whenever laelaps_config_t changes layout
+// A stored blob with a different schema is ignored and defaults are used
+#define CFG_SCHEMA_VERSION  12
+
+// Number of RAM copies of the configuration
+// Readers use the active copy while writers fill one of the others
+#define CFG_NUM_SLOTS       3
+// A replaced copy is only refilled once every reader is done with it. Readers
+// hold a copy for one iteration, this is on top of the control period
+// A reader must not hold the pointer from Config_Get across a blocking call,
+// it calls Config_Get again after every wait
+#define CFG_GRACE_MS        100
+// Config_Update waits for readers in slices this long, beating in between
+#define CFG_WAIT_SLICE_MS   100
+#define CFG_CACHE_LINE      32
+
+#define CFG_SSID_MAX_LEN    32
+#define CFG_PASS_MAX_LEN    64
+#define CFG_NUM_SERVOS      8
+#define CFG_SERVO_UNUSED    -1
+#define CFG_NUM_FENCES      4
+#define CFG_FENCE_MAX_VERTICES  16
+#define CFG_HOST_MAX_LEN    39                  // Fits a dotted IPv4 or full IPv6 address
+
+
+// Custom data types
+// Struct to hold the settings of one servo / ESC output channel
+// A pin of CFG_SERVO_UNUSED disables the channel
+// protocol is one of SERVO_PROTO_ in servo.h
+typedef struct Servo_Channel_Config{
+    int8_t pin;
+    uint8_t protocol;
+    int16_t min_deg;                            // (live)
+    int16_t max_deg;                            // (live)
+    uint16_t min_us;                            // (live)
+    uint16_t max_us;                            // (live)
+} servo_channel_config_t;
+
+// Struct to hold one geofence polygon
+// type is FENCE_KEEP_IN or FENCE_KEEP_OUT from failsafe.h
+// Fewer than 3 vertices disables the fence
+typedef struct Fence_Config{
+    uint8_t type;
+    uint8_t num_vertices;
+    float lat[CFG_FENCE_MAX_VERTICES];
+    float lon[CFG_FENCE_MAX_VERTICES];
+} fence_config_t;
+
+// Struct to hold all runtime tunable parameters
+// Fields marked (live) take effect on the next loop iteration after Config_Update
+// All other fields are only read at boot
+typedef struct Laelaps_Config{
+    uint32_t schema_version;
+    uint32_t version;                           // Incremented on every update, never stored
+    uint8_t fence_slot;                         // Fence grids built from this copy, never stored
+
+    // Wi-Fi
+    char wifi_ssid[CFG_SSID_MAX_LEN + 1];
+    char wifi_pass[CFG_PASS_MAX_LEN + 1];
+    uint8_t wifi_max_retry;
+
+    // GPS
+    uint32_t gps_baud;                          // (live)
+    int8_t gps_pps_pin;                         // -1 for none
+
+    // Servos
+    servo_channel_config_t servo[CFG_NUM_SERVOS];
+
+    // Control loop
+    uint32_t control_period_us;                 // (live)
+    int16_t control_step_deg;                   // (live)
+    uint32_t control_jitter_budget_us;          // (live) wake up jitter reported as over budget
+    uint8_t control_record;                     // (live) stream control loop inputs for replay
+
+    // Failsafe
+    uint8_t failsafe_enable;                    // (live) FAILSAFE_ reason mask
+    uint8_t failsafe_action;                    // (live)
+    uint8_t failsafe_min_sats;                  // (live)
+    uint16_t failsafe_fix_timeout_ms;           // (live)
+    uint16_t failsafe_link_timeout_ms;          // (live)
+    int16_t failsafe_pos[CFG_NUM_SERVOS];       // (live)
+    fence_config_t fence[CFG_NUM_FENCES];       // (live)
+
+    // Telemetry
+    char tlm_host[CFG_HOST_MAX_LEN + 1];        // (live) used on the next reconnect
+    uint16_t tlm_port;                          // (live) used on the next reconnect
+    uint16_t ota_port;                          // (live) update server on tlm_host, 0 disables updates
+
+    // Fleet
+    uint16_t unit_id;                           // 0 for one derived from the eFuse MAC
+    uint8_t fleet_num_slots;                    // (live) 0 or 1 disables slotted transmission
+    uint8_t fleet_slot;                         // (live) this unit's slot, 0 to fleet_num_slots - 1
+    uint16_t fleet_frame_ms;                    // (live) every unit gets one slot per frame
+
+    // Power
+    uint8_t pm_enable;
+    uint8_t pm_light_sleep;
+    uint16_t pm_max_mhz;
+    uint16_t pm_min_mhz;
+    uint8_t wifi_ps;                            // wifi_ps_type_t
+    uint16_t tlm_batch_ms;                      // (live) 0 flushes telemetry right away
+} __attribute__((aligned(CFG_CACHE_LINE))) laelaps_config_t;
+
+#endif
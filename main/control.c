@@ -13,35 +13,299 @@ Last Built With ESP-IDF v5.2.2
 // Include Header Libraries
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "sdkconfig.h"
 #include "control.h"
+#include "config.h"
+#include "gps.h"
+#include "tcp_client.h"
+#include "telemetry.h"
+#include "power.h"
+#include "health.h"
 #include "functions.h"
 #include "init.h"
 
-// Temp control function
-// Will add functionality later
+_Static_assert(CONTROL_PERIOD_MAX_US / 1000 <= HEALTH_PERIOD_MAX_MS, "The longest control period would trip the task watchdog");
+
+// Global to this file
+// Only used by Control_Loop through Control_Record
+static control_rec_config_t control_rec_cfg;    // Too big for the task stack
+static uint32_t control_rec_cfg_version = 0;    // Config version the vehicle last recorded in full
+static int64_t control_rec_gps_us = -1;         // rx_time_us of the GPS snapshot last recorded
+// USE SPINLOCK, the last finished timing window, logged by the reporting task
+static portMUX_TYPE control_report_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static control_timing_t control_report;
+static int64_t control_report_end_us = 0;
+static uint32_t control_report_period_us = 0;
+static uint8_t control_report_ready = 0;
+static const char* CTRL_TAG = "Control_Loop";
+
+// Control_Send_State
+// Queues one state frame for the ground station. Never blocks
+// Returns the result of Telemetry_Send
+static int Control_Send_State(const gps_data_t *gps, uint8_t failsafe){
+    tlm_state_t state;
+    uint8_t i;
+
+    state.lat = gps->lat;
+    state.lon = gps->lon;
+    state.altitude = gps->altitude;
+    state.sats = gps->sats;
+    state.failsafe = failsafe;
+    for(i = 0; i < TLM_NUM_SERVOS; i++){
+        state.servo[i] = Get_Servo_Position(i);
+    }
+    return Telemetry_Send(TLM_TYPE_STATE, &state, sizeof(state));
+}
+
+
+// Control_Record_Config
+// Sends the configuration in CONTROL_REC_CHUNK pieces, Wi-Fi credentials blanked
+// Returns 0 once every piece is queued, the result of Telemetry_Send otherwise
+static int Control_Record_Config(const laelaps_config_t *cfg){
+    const size_t secret_lo = offsetof(laelaps_config_t, wifi_ssid);
+    const size_t secret_hi = offsetof(laelaps_config_t, wifi_pass) + sizeof(cfg->wifi_pass);
+    size_t offset;
+    size_t len;
+    size_t lo;
+    size_t hi;
+    int err;
+
+    for(offset = 0; offset < sizeof(laelaps_config_t); offset += len){
+        len = sizeof(laelaps_config_t) - offset;
+        if(len > CONTROL_REC_CHUNK) len = CONTROL_REC_CHUNK;
+
+        control_rec_cfg.kind = CONTROL_REC_CONFIG;
+        control_rec_cfg.version = cfg->version;
+        control_rec_cfg.offset = (uint16_t) offset;
+        control_rec_cfg.total = (uint16_t) sizeof(laelaps_config_t);
+        memcpy(control_rec_cfg.data, (const uint8_t *) cfg + offset, len);
+        lo = (secret_lo > offset) ? secret_lo : offset;
+        hi = (secret_hi < offset + len) ? secret_hi : offset + len;
+        if(lo < hi) memset(&control_rec_cfg.data[lo - offset], 0, hi - lo);
+
+        err = Telemetry_Send(TLM_TYPE_REPLAY, &control_rec_cfg, (uint16_t) (offsetof(control_rec_config_t, data) + len));
+        if(err < 0) return err;
+    }
+    return 0;
+}
+
+
+// Control_Record
+// Queues the replay records of one step while control_record is set. Never blocks
+// Config and GPS records that did not fit are retried on the next step, and
+// the step record is only sent once they are out
+static void Control_Record(const laelaps_config_t *cfg, const control_inputs_t *in, const control_state_t *state,
+                           const control_outputs_t *out, uint32_t iteration, uint32_t step_us){
+    control_rec_gps_t rec_gps;
+    control_rec_step_t rec_step;
+
+    if(!cfg->control_record){
+        control_rec_cfg_version = 0;
+        control_rec_gps_us = -1;
+        return;
+    }
+
+    if(control_rec_cfg_version != cfg->version){
+        if(Control_Record_Config(cfg) < 0) return;
+        control_rec_cfg_version = cfg->version;
+    }
+    if(control_rec_gps_us != in->gps.rx_time_us){
+        rec_gps.kind = CONTROL_REC_GPS;
+        rec_gps.gps = in->gps;
+        if(Telemetry_Send(TLM_TYPE_REPLAY, &rec_gps, sizeof(rec_gps)) < 0) return;
+        control_rec_gps_us = in->gps.rx_time_us;
+    }
+
+    rec_step.kind = CONTROL_REC_STEP;
+    rec_step.iteration = iteration;
+    rec_step.cfg_version = cfg->version;
+    rec_step.now_us = in->now_us;
+    rec_step.link_down_us = (in->link_down_us > INT32_MAX) ? INT32_MAX : (int32_t) in->link_down_us;
+    rec_step.step_us = step_us;
+    rec_step.state = *state;
+    rec_step.out = *out;
+    Telemetry_Send(TLM_TYPE_REPLAY, &rec_step, sizeof(rec_step));
+}
+
+
+// Control_Publish_Timing
+// Hands the loop timing of one window to the reporting task and starts the next
+// Only copies, logging is left to Control_Report_Timing outside the loop
+static void Control_Publish_Timing(control_timing_t *t, int64_t now_us, uint32_t period_us){
+    portENTER_CRITICAL(&control_report_spinlock);
+    control_report = *t;
+    control_report_end_us = now_us;
+    control_report_period_us = period_us;
+    control_report_ready = 1;
+    portEXIT_CRITICAL(&control_report_spinlock);
+
+    memset(t, 0, sizeof(control_timing_t));
+    t->window_start_us = now_us;
+}
+
+
+// Control_Report_Timing
+// Logs the loop timing of the last finished window, once
+// The step's share of the period shows how much faster the loop could run
+// Called by the OTA task with the memory report, never from the loop
+void Control_Report_Timing(void){
+    control_timing_t report;
+    control_timing_t *t = &report;
+    int64_t window_us;
+    uint32_t period_us;
+
+    portENTER_CRITICAL(&control_report_spinlock);
+    if(!control_report_ready){
+        portEXIT_CRITICAL(&control_report_spinlock);
+        return;
+    }
+    report = control_report;
+    window_us = control_report_end_us - report.window_start_us;
+    period_us = control_report_period_us;
+    control_report_ready = 0;
+    portEXIT_CRITICAL(&control_report_spinlock);
+
+    if(t->iterations && (window_us > 0)){
+        ESP_LOGI(CTRL_TAG, "%lu iterations, jitter mean %lld max %lld us, %lu over budget, busy mean %lld max %lld us (%lld.%lld%% duty)",
+                 (unsigned long) t->iterations, (long long) (t->jitter_sum_us / t->iterations), (long long) t->jitter_max_us,
+                 (unsigned long) t->over_budget, (long long) (t->busy_sum_us / t->iterations), (long long) t->busy_max_us,
+                 (long long) (t->busy_sum_us * 100 / window_us), (long long) ((t->busy_sum_us * 1000 / window_us) % 10));
+        ESP_LOGI(CTRL_TAG, "Step mean %lld max %lu us, %lu.%lu%% of the %lu us period",
+                 (long long) (t->step_sum_us / t->iterations), (unsigned long) t->step_max_us,
+                 (unsigned long) ((uint64_t) t->step_max_us * 100 / period_us),
+                 (unsigned long) (((uint64_t) t->step_max_us * 1000 / period_us) % 10), (unsigned long) period_us);
+        if(t->over_budget){
+            ESP_LOGW(CTRL_TAG, "Wake up jitter over budget %lu times", (unsigned long) t->over_budget);
+        }
+    }
+    if(t->failsafe_changes){
+        ESP_LOGW(CTRL_TAG, "Failsafe changed %lu times, now 0x%02x", (unsigned long) t->failsafe_changes, t->failsafe);
+    }
+}
+
+
+// Control_Tick
+// esp_timer callback, wakes the control loop once per period
+// The FreeRTOS tick is too coarse for periods of a few ms
+static void Control_Tick(void *args){
+    xTaskNotifyGive((TaskHandle_t) args);
+}
+
+
+// Control_Loop
+// Runs Control_Step at the configured rate and carries out its outputs
+// All inputs of the step are read here, so a recording of them replays exactly
 void Control_Loop(void *args){
-    //const char* CTRL_TAG = "Control_Loop";
-    int16_t servo1_pos = -90;
-    int16_t servo2_pos = 90;
-    int16_t servo_min_pos = -90;
-    int16_t servo_max_pos = 90;
-    int16_t servo1_step = 10;
-    int16_t servo2_step = 10;
+    const laelaps_config_t *cfg = Config_Get();
+    control_state_t state;
+    control_state_t state_before;
+    control_inputs_t in;
+    control_outputs_t out;
+    uint8_t last_failsafe = 0;
+    uint32_t period_us = cfg->control_period_us;
+    uint32_t period_ms = (period_us + 999) / 1000;
+    int8_t health_id = Health_Register(period_ms);
+    uint32_t iteration = 0;
+    uint32_t wakes = 0;
+    uint8_t tlm_div = 1;
+    uint8_t i;
+    control_timing_t timing = {0};
+    esp_timer_handle_t tick_timer;
+    esp_timer_create_args_t tick_timer_args = {
+        .callback = Control_Tick,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .name = "control",
+    };
+    int64_t sched_us;
+    int64_t wake_us;
+    int64_t jitter_us = 0;
+    int64_t busy_us;
+    uint32_t step_us;
+
+    Control_Step_Init(cfg, &state);
+    ESP_ERROR_CHECK(esp_timer_create(&tick_timer_args, &tick_timer));
+    Memory_Task_Ready();
+    ESP_ERROR_CHECK(esp_timer_start_periodic(tick_timer, period_us));
+    sched_us = esp_timer_get_time();            // The first tick is one period after this
+    timing.window_start_us = sched_us;
 
     while(1){
-        //ESP_LOGI(CTRL_TAG, "%d deg", servo_pos);
-        Set_Servo(0, servo1_pos);
-        Set_Servo(1, servo2_pos);
+        // Timestamp before the lock, raising the frequency takes time too
+        wake_us = esp_timer_get_time();
+        Power_Acquire(POWER_LOCK_CONTROL);
+        iteration++;
+        // Pick up any config update once per iteration, the copy from before the wait may be replaced
+        cfg = Config_Get();
+
+        // More than one pending tick means whole periods were missed, the
+        // lateness is against the latest. A timeout counts as one period
+        if(iteration > 1){
+            sched_us += (int64_t) period_us * (wakes ? wakes : 1);
+            jitter_us = wake_us - sched_us;
+            if(jitter_us < 0) jitter_us = -jitter_us;
+            timing.jitter_sum_us += jitter_us;
+            if(jitter_us > timing.jitter_max_us) timing.jitter_max_us = jitter_us;
+            if(jitter_us > cfg->control_jitter_budget_us) timing.over_budget++;
+        }
+
+        if(cfg->control_period_us != period_us){
+            period_us = cfg->control_period_us;
+            period_ms = (period_us + 999) / 1000;
+            Health_Set_Period(health_id, period_ms);
+            esp_timer_stop(tick_timer);
+            ESP_ERROR_CHECK(esp_timer_start_periodic(tick_timer, period_us));
+            sched_us = esp_timer_get_time();
+        }
+        Health_Beat(health_id);
+
+        Get_GPS_Data(&in.gps);
+        in.link_down_us = Wifi_Link_Down_us();
+        in.now_us = esp_timer_get_time();
+        state_before = state;
+        Control_Step(cfg, &state, &in, &out);
+        step_us = (uint32_t) (esp_timer_get_time() - in.now_us);
+        timing.step_sum_us += step_us;
+        if(step_us > timing.step_max_us) timing.step_max_us = step_us;
+
+        if(out.failsafe != last_failsafe){
+            timing.failsafe_changes++;
+            last_failsafe = out.failsafe;
+        }
+        timing.failsafe = out.failsafe;
+
+        // Back off while the link cannot keep up, recover once frames fit again
+        if((iteration % tlm_div) == 0){
+            if(Control_Send_State(&in.gps, out.failsafe) == TCP_ERR_BACKPRESSURE){
+                if(tlm_div < CONTROL_TLM_MAX_DIV) tlm_div <<= 1;
+            }
+            else if(tlm_div > 1){
+                tlm_div >>= 1;
+            }
+        }
+        for(i = 0; i < CFG_NUM_SERVOS; i++){
+            if(out.servo_mask & (1 << i)) Set_Servo(i, out.servo[i]);
+        }
+        Control_Record(cfg, &in, &state_before, &out, iteration, step_us);
 
-        servo1_pos += servo1_step;
-        servo2_pos += servo2_step;
-        if((servo1_pos <= servo_min_pos) || (servo1_pos >= servo_max_pos)) servo1_step *= -1;
-        if((servo2_pos <= servo_min_pos) || (servo2_pos >= servo_max_pos)) servo2_step *= -1;
+        busy_us = esp_timer_get_time() - wake_us;
+        timing.iterations++;
+        timing.busy_sum_us += busy_us;
+        if(busy_us > timing.busy_max_us) timing.busy_max_us = busy_us;
+        // A new image is only kept once the loop shows it still wakes on schedule
+        Ota_Control_Check(jitter_us <= cfg->control_jitter_budget_us, out.failsafe);
+        if(wake_us - timing.window_start_us >= (int64_t) CONTROL_TIMING_REPORT_MS * 1000){
+            Control_Publish_Timing(&timing, wake_us, period_us);
+        }
 
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        // Fixed rate schedule so wake up jitter can be measured against it
+        // The timeout only keeps the failsafe running should the timer stop
+        Power_Release(POWER_LOCK_CONTROL);
+        wakes = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2 * period_ms) + 1);
     }
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 /*
 This file holds the macro definitions for control.h
+The control step types and the replay record format are shared with the
+replay tool, plain C, no ESP-IDF headers
 
 Author:         James Sorber
 Contact:        jrsorber@ncsu.edu
@@ -11,5 +13,110 @@ Last Built With ESP-IDF v5.2.2
 #ifndef CONTROL_H
 #define CONTROL_H
 
+#include <stdint.h>
+#include "config.h"
+#include "gps.h"
+
+// Defaults, used when no configuration is stored in NVS
+#define CONTROL_PERIOD_US   1000000
+#define CONTROL_STEP_DEG    10
+#define CONTROL_RECORD      0                   // Replay recording off
+
+// Telemetry is sent every iteration until the TX queue pushes back, then
+// every 2nd, 4th... iteration up to this divider until it drains again
+#define CONTROL_TLM_MAX_DIV 16
+
+// The loop is woken by an esp_timer, not the tick, so periods are in us
+// Below the minimum the esp_timer task and the step itself cannot keep up
+// Above the maximum the loop would beat too rarely for the task watchdog
+#define CONTROL_PERIOD_MIN_US       1000
+#define CONTROL_PERIOD_MAX_US       2000000
+
+// Loop timing is logged and reset this often
+#define CONTROL_TIMING_REPORT_MS    10000
+
+// The sweep drives the first servos only
+#define CONTROL_SWEEP_SERVOS        2
+
+// Replay records, sent as TLM_TYPE_REPLAY payloads while control_record is set
+// CONFIG carries the configuration in chunks whenever its version changes
+// GPS carries the snapshot whenever a new fix arrived
+// STEP carries the rest of the inputs, the state before the step and the outputs
+// A step is only sent once the config and GPS records it depends on went out
+#define CONTROL_REC_CONFIG          1
+#define CONTROL_REC_GPS             2
+#define CONTROL_REC_STEP            3
+#define CONTROL_REC_CHUNK           480
+
+
+// Custom data types
+// Loop timing over one report window
+// Jitter is how late a wake was against the timer's schedule
+// Busy is the time from wake to sleep, i.e. with the max frequency lock held
+// Step is the time Control_Step took, fences and failsafe included
+// Failsafe changes are counted here rather than logged from the loop
+typedef struct Control_Timing{
+    int64_t window_start_us;
+    uint32_t iterations;
+    uint32_t over_budget;
+    int64_t jitter_sum_us;
+    int64_t jitter_max_us;
+    int64_t busy_sum_us;
+    int64_t busy_max_us;
+    int64_t step_sum_us;
+    uint32_t step_max_us;
+    uint32_t failsafe_changes;
+    uint8_t failsafe;                           // Raised at the end of the window
+} control_timing_t;
+
+// Everything Control_Step carries from one step to the next
+typedef struct Control_State{
+    int16_t sweep_pos[CONTROL_SWEEP_SERVOS];
+    int16_t sweep_dir[CONTROL_SWEEP_SERVOS];
+} control_state_t;
+
+// Everything Control_Step reads besides the configuration and its state
+typedef struct Control_Inputs{
+    gps_data_t gps;                             // Get_GPS_Data snapshot
+    int64_t now_us;                             // esp_timer time of the step
+    int64_t link_down_us;                       // Wifi_Link_Down_us
+} control_inputs_t;
+
+// What the step wants done. The caller drives the servos
+typedef struct Control_Outputs{
+    uint8_t failsafe;                           // FAILSAFE_ reasons
+    uint8_t servo_mask;                         // Bit i set if servo[i] is to be driven
+    int16_t servo[CFG_NUM_SERVOS];
+} control_outputs_t;
+
+typedef struct __attribute__((packed)) Control_Rec_Config{
+    uint8_t kind;
+    uint32_t version;                           // laelaps_config_t version
+    uint16_t offset;
+    uint16_t total;                             // sizeof(laelaps_config_t) on the vehicle
+    uint8_t data[CONTROL_REC_CHUNK];            // Up to the end of the payload
+} control_rec_config_t;
+
+typedef struct __attribute__((packed)) Control_Rec_GPS{
+    uint8_t kind;
+    gps_data_t gps;
+} control_rec_gps_t;
+
+typedef struct __attribute__((packed)) Control_Rec_Step{
+    uint8_t kind;
+    uint32_t iteration;
+    uint32_t cfg_version;
+    int64_t now_us;
+    int32_t link_down_us;                       // Clamped, failsafe timeouts are far below
+    uint32_t step_us;                           // Time Control_Step took on the vehicle
+    control_state_t state;                      // Before the step
+    control_outputs_t out;
+} control_rec_step_t;
+
+
+// Function prototypes, shared with the replay tool so not in functions.h
+void Control_Step_Init(const laelaps_config_t *cfg, control_state_t *state);
+void Control_Step(const laelaps_config_t *cfg, control_state_t *state, const control_inputs_t *in, control_outputs_t *out);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*
+This file holds the control law as a pure step function
+Control_Step only reads its arguments and the fence grids its configuration
+names, and only writes its state and outputs. GPS reads, time and
+the servo drivers stay in Control_Loop, so the replay tool can run the same
+code on the host against a recorded flight
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "gps.h"
+#include "failsafe.h"
+#include "control.h"
+
+
+// Control_Step_Init
+// Sets the state a freshly started control loop begins with
+void Control_Step_Init(const laelaps_config_t *cfg, control_state_t *state){
+    state->sweep_pos[0] = cfg->servo[0].min_deg;
+    state->sweep_pos[1] = cfg->servo[1].max_deg;
+    state->sweep_dir[0] = 1;
+    state->sweep_dir[1] = 1;
+}
+
+
+// Control_Step
+// One control loop iteration. Safety checks come first, nothing else
+// drives the servos while failsafe is active
+void Control_Step(const laelaps_config_t *cfg, control_state_t *state, const control_inputs_t *in, control_outputs_t *out){
+    uint8_t i;
+
+    memset(out, 0, sizeof(control_outputs_t));
+    out->failsafe = Failsafe_Evaluate(cfg, &in->gps, in->now_us, in->link_down_us);
+    if(out->failsafe){
+        out->servo_mask = Failsafe_Outputs(cfg, out->servo);
+        return;
+    }
+
+    // Temp control law, sweeps the servos back and forth
+    for(i = 0; i < CONTROL_SWEEP_SERVOS; i++){
+        out->servo[i] = state->sweep_pos[i];
+        out->servo_mask |= 1 << i;
+
+        state->sweep_pos[i] += state->sweep_dir[i] * cfg->control_step_deg;
+        if(state->sweep_pos[i] <= cfg->servo[i].min_deg){ state->sweep_pos[i] = cfg->servo[i].min_deg; state->sweep_dir[i] = 1; }
+        if(state->sweep_pos[i] >= cfg->servo[i].max_deg){ state->sweep_pos[i] = cfg->servo[i].max_deg; state->sweep_dir[i] = -1; }
+    }
+}
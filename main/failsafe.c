@@ -0,0 +1,236 @@
+/*
+This file holds the source code for the geofence and failsafe engine
+Failsafe_Evaluate runs every control loop iteration, it does not allocate
+or block. Fence lookup grids are built from the configuration outside of
+the loop, into a slot the configuration copy names, so the one pointer a
+step is given always pairs a configuration with its own fences
+No ESP-IDF calls, the replay tool builds this file on the host
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "servo.h"
+#include "gps.h"
+#include "failsafe.h"
+
+_Static_assert(CFG_FENCE_MAX_VERTICES <= 16, "row_edges is a 16 bit mask");
+
+
+// Global to this file
+// One set of grids per configuration slot, found through cfg->fence_slot
+// A slot is only rebuilt together with the configuration copy that names it
+static fence_index_t fence_slots[CFG_NUM_SLOTS][CFG_NUM_FENCES];
+
+
+// Fence_Ray_Cast
+// Even-odd point in polygon test over the edges set in edge_mask
+// Edge i runs from vertex i to vertex i + 1 (wrapping)
+// A point on an edge is inside. The even-odd count alone puts the lower
+// and left edges inside and the upper and right ones outside
+static uint8_t Fence_Ray_Cast(const fence_index_t *f, uint16_t edge_mask, float lat, float lon){
+    uint8_t inside = FALSE;
+    uint8_t i;
+    uint8_t j;
+    float cross_lon;
+
+    for(i = 0; i < f->num_vertices; i++){
+        if(!(edge_mask & (1 << i))) continue;
+        j = (i + 1 == f->num_vertices) ? 0 : i + 1;
+        // Within the edge's box and on its line
+        if(((lat >= f->lat[i]) || (lat >= f->lat[j])) && ((lat <= f->lat[i]) || (lat <= f->lat[j]))
+           && ((lon >= f->lon[i]) || (lon >= f->lon[j])) && ((lon <= f->lon[i]) || (lon <= f->lon[j]))
+           && ((f->lon[j] - f->lon[i]) * (lat - f->lat[i]) == (f->lat[j] - f->lat[i]) * (lon - f->lon[i]))){
+            return TRUE;
+        }
+        if((f->lat[i] > lat) != (f->lat[j] > lat)){
+            cross_lon = (f->lon[j] - f->lon[i]) * (lat - f->lat[i]) / (f->lat[j] - f->lat[i]) + f->lon[i];
+            if(lon < cross_lon) inside = !inside;
+        }
+    }
+    return inside;
+}
+
+
+// Fence_Contains
+// Returns TRUE if the point is inside the fence polygon
+// Both edges of the bounding box count as inside, the max edge falls in the last row / column
+// Constant time for cells away from the boundary, one row's edges otherwise
+static uint8_t Fence_Contains(const fence_index_t *f, float lat, float lon){
+    int row;
+    int col;
+    uint8_t cell;
+
+    if((lat < f->min_lat) || (lat > f->max_lat) || (lon < f->min_lon) || (lon > f->max_lon)){
+        return FALSE;
+    }
+
+    row = (int) ((lat - f->min_lat) * f->inv_cell_lat);
+    col = (int) ((lon - f->min_lon) * f->inv_cell_lon);
+    if(row >= FENCE_GRID_N) row = FENCE_GRID_N - 1;
+    if(col >= FENCE_GRID_N) col = FENCE_GRID_N - 1;
+
+    cell = f->cell[row][col];
+    if(cell != FENCE_CELL_EDGE) return cell;
+    return Fence_Ray_Cast(f, f->row_edges[row], lat, lon);
+}
+
+
+// Fence_Build_Index
+// Fills the lookup grid of one fence from its configuration
+static void Fence_Build_Index(const fence_config_t *fc, fence_index_t *f){
+    uint16_t all_edges;
+    float cell_lat;
+    float cell_lon;
+    float r_lo, r_hi, c_lo, c_hi;
+    float e_lat_lo, e_lat_hi, e_lon_lo, e_lon_hi;
+    uint8_t i, j;
+    int row, col;
+
+    memset(f, 0, sizeof(fence_index_t));
+    if(fc->num_vertices < 3) return;
+
+    f->type = fc->type;
+    f->num_vertices = fc->num_vertices;
+    f->min_lat = f->max_lat = fc->lat[0];
+    f->min_lon = f->max_lon = fc->lon[0];
+    for(i = 0; i < fc->num_vertices; i++){
+        f->lat[i] = fc->lat[i];
+        f->lon[i] = fc->lon[i];
+        if(fc->lat[i] < f->min_lat) f->min_lat = fc->lat[i];
+        if(fc->lat[i] > f->max_lat) f->max_lat = fc->lat[i];
+        if(fc->lon[i] < f->min_lon) f->min_lon = fc->lon[i];
+        if(fc->lon[i] > f->max_lon) f->max_lon = fc->lon[i];
+    }
+    if((f->max_lat <= f->min_lat) || (f->max_lon <= f->min_lon)) return;
+
+    cell_lat = (f->max_lat - f->min_lat) / FENCE_GRID_N;
+    cell_lon = (f->max_lon - f->min_lon) / FENCE_GRID_N;
+    f->inv_cell_lat = 1.0f / cell_lat;
+    f->inv_cell_lon = 1.0f / cell_lon;
+    all_edges = (uint16_t) ((1UL << f->num_vertices) - 1);
+
+    for(row = 0; row < FENCE_GRID_N; row++){
+        r_lo = f->min_lat + row * cell_lat;
+        r_hi = r_lo + cell_lat;
+
+        for(i = 0; i < f->num_vertices; i++){
+            j = (i + 1 == f->num_vertices) ? 0 : i + 1;
+            e_lat_lo = (f->lat[i] < f->lat[j]) ? f->lat[i] : f->lat[j];
+            e_lat_hi = (f->lat[i] < f->lat[j]) ? f->lat[j] : f->lat[i];
+            if((e_lat_hi >= r_lo) && (e_lat_lo <= r_hi)) f->row_edges[row] |= 1 << i;
+        }
+
+        for(col = 0; col < FENCE_GRID_N; col++){
+            c_lo = f->min_lon + col * cell_lon;
+            c_hi = c_lo + cell_lon;
+
+            // Conservative, an edge whose bounding box touches the cell marks it EDGE
+            f->cell[row][col] = FENCE_CELL_OUT;
+            for(i = 0; i < f->num_vertices; i++){
+                if(!(f->row_edges[row] & (1 << i))) continue;
+                j = (i + 1 == f->num_vertices) ? 0 : i + 1;
+                e_lon_lo = (f->lon[i] < f->lon[j]) ? f->lon[i] : f->lon[j];
+                e_lon_hi = (f->lon[i] < f->lon[j]) ? f->lon[j] : f->lon[i];
+                if((e_lon_hi >= c_lo) && (e_lon_lo <= c_hi)){
+                    f->cell[row][col] = FENCE_CELL_EDGE;
+                    break;
+                }
+            }
+            if(f->cell[row][col] != FENCE_CELL_EDGE){
+                f->cell[row][col] = Fence_Ray_Cast(f, all_edges, r_lo + cell_lat / 2, c_lo + cell_lon / 2) ? FENCE_CELL_IN : FENCE_CELL_OUT;
+            }
+        }
+    }
+    f->active = TRUE;
+}
+
+
+// Failsafe_Build_Fences
+// Builds the lookup grids for all fences in a configuration into slot and
+// points the configuration at them. Must be done before it is published
+// Called by Config_Init and Config_Update, never from the control loop
+void Failsafe_Build_Fences(laelaps_config_t *cfg, uint8_t slot){
+    uint8_t i;
+
+    for(i = 0; i < CFG_NUM_FENCES; i++){
+        Fence_Build_Index(&cfg->fence[i], &fence_slots[slot][i]);
+    }
+    cfg->fence_slot = slot;
+}
+
+
+// Failsafe_Evaluate
+// Checks fix, link and geofences. Runs every control loop iteration
+// Takes a GPS snapshot, the current esp_timer time and Wifi_Link_Down_us
+// Returns bitmask of FAILSAFE_ reasons that are enabled and active, 0 if all good
+uint8_t Failsafe_Evaluate(const laelaps_config_t *cfg, const gps_data_t *gps, int64_t now_us, int64_t link_down_us){
+    const fence_index_t *fences;
+    uint8_t reasons = 0;
+    uint8_t inside;
+    uint8_t i;
+
+    if(cfg->fence_slot >= CFG_NUM_SLOTS){
+        return 0;
+    }
+    fences = fence_slots[cfg->fence_slot];
+
+    if(gps->sats < cfg->failsafe_min_sats){
+        reasons |= FAILSAFE_NO_FIX;
+    }
+    if((gps->rx_time_us == 0) || (now_us - gps->rx_time_us > (int64_t) cfg->failsafe_fix_timeout_ms * 1000)){
+        reasons |= FAILSAFE_FIX_STALE;
+    }
+
+    if(link_down_us > (int64_t) cfg->failsafe_link_timeout_ms * 1000){
+        reasons |= FAILSAFE_LINK_LOST;
+    }
+
+    // A position without a fix means nothing, only check fences on good data
+    if(!(reasons & (FAILSAFE_NO_FIX | FAILSAFE_FIX_STALE))){
+        for(i = 0; i < CFG_NUM_FENCES; i++){
+            if(!fences[i].active) continue;
+            inside = Fence_Contains(&fences[i], gps->lat, gps->lon);
+            if((fences[i].type == FENCE_KEEP_IN) != inside){
+                reasons |= FAILSAFE_GEOFENCE;
+                break;
+            }
+        }
+    }
+
+    return reasons & cfg->failsafe_enable;
+}
+
+
+// Failsafe_Outputs
+// Fills pos with the configured failsafe action
+// Returns bitmask of the servos to drive, 0 to hold all outputs
+uint8_t Failsafe_Outputs(const laelaps_config_t *cfg, int16_t *pos){
+    uint8_t mask = 0;
+    uint8_t i;
+
+    if(cfg->failsafe_action == FAILSAFE_ACT_HOLD) return 0;
+
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        if(cfg->servo[i].pin == CFG_SERVO_UNUSED) continue;
+        if(cfg->failsafe_action == FAILSAFE_ACT_PRESET){
+            pos[i] = cfg->failsafe_pos[i];
+        }
+        else if(SERVO_IS_DSHOT(cfg->servo[i].protocol)){
+            // Center on an ESC is half throttle, stop the motor instead
+            pos[i] = cfg->servo[i].min_deg;
+        }
+        else{
+            pos[i] = (cfg->servo[i].min_deg + cfg->servo[i].max_deg) / 2;
+        }
+        mask |= 1 << i;
+    }
+    return mask;
+}
@@ -0,0 +1,73 @@
+/*
+This file holds the macro definitions and types for failsafe.c
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef FAILSAFE_H
+#define FAILSAFE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "gps.h"
+
+// Defaults, used when no configuration is stored in NVS
+#define FAILSAFE_FIX_TIMEOUT_MS     2000
+#define FAILSAFE_LINK_TIMEOUT_MS    3000
+#define FAILSAFE_MIN_SATS           4
+
+// Reasons, bitmask returned by Failsafe_Evaluate
+// Also used as the enable mask in the configuration
+#define FAILSAFE_NO_FIX             (1 << 0)
+#define FAILSAFE_FIX_STALE          (1 << 1)
+#define FAILSAFE_LINK_LOST          (1 << 2)
+#define FAILSAFE_GEOFENCE           (1 << 3)
+#define FAILSAFE_ALL                0x0F
+
+// Actions on the servos while any enabled reason is active
+#define FAILSAFE_ACT_HOLD           0           // Stop updating, outputs keep last value
+#define FAILSAFE_ACT_CENTER         1           // Middle of each channel's range
+#define FAILSAFE_ACT_PRESET         2           // failsafe_pos[] from the configuration
+
+// Fence types
+#define FENCE_KEEP_IN               0
+#define FENCE_KEEP_OUT              1
+
+// Each fence's bounding box is split into FENCE_GRID_N x FENCE_GRID_N cells
+// Cells fully inside or outside answer a containment check directly
+// Cells crossed by an edge fall back to a ray cast over that row's edges only
+#define FENCE_GRID_N                16
+#define FENCE_CELL_OUT              0
+#define FENCE_CELL_IN               1
+#define FENCE_CELL_EDGE             2
+
+
+// Custom data types
+// Precomputed lookup for one fence
+typedef struct Fence_Index{
+    uint8_t active;
+    uint8_t type;
+    uint8_t num_vertices;
+    float lat[CFG_FENCE_MAX_VERTICES];
+    float lon[CFG_FENCE_MAX_VERTICES];
+    float min_lat;
+    float min_lon;
+    float max_lat;
+    float max_lon;
+    float inv_cell_lat;                         // Cells per degree
+    float inv_cell_lon;
+    uint8_t cell[FENCE_GRID_N][FENCE_GRID_N];   // [lat row][lon col]
+    uint16_t row_edges[FENCE_GRID_N];           // Bit i set if edge i spans the row's latitudes
+} fence_index_t;
+
+
+// Function prototypes, shared with the replay tool so not in functions.h
+void Failsafe_Build_Fences(laelaps_config_t *cfg, uint8_t slot);
+uint8_t Failsafe_Evaluate(const laelaps_config_t *cfg, const gps_data_t *gps, int64_t now_us, int64_t link_down_us);
+uint8_t Failsafe_Outputs(const laelaps_config_t *cfg, int16_t *pos);
+
+#endif
@@ -14,29 +14,92 @@ Last Built With ESP-IDF v5.2.2
 
 // Forward declaration of custom types
 typedef struct GPS_Data gps_data_t;
+typedef struct Laelaps_Config laelaps_config_t;
+typedef struct Time_Sync_State time_sync_state_t;
+typedef struct Health_Task health_task_t;
+typedef struct Tcp_Vec tcp_vec_t;
+typedef struct Tcp_Conn tcp_conn_t;
+
+// CONFIG.C
+void Config_Init(void);
+void Config_Load_Defaults(laelaps_config_t *cfg);
+esp_err_t Config_Validate(const laelaps_config_t *cfg);
+const laelaps_config_t* Config_Get(void);
+esp_err_t Config_Update(const laelaps_config_t *new_cfg, uint8_t persist, int8_t health_id);
+
+// HEALTH.C
+void Init_Health(void);
+int8_t Health_Register(uint32_t period_ms);
+void Health_Set_Period(int8_t id, uint32_t period_ms);
+void Health_Beat(int8_t id);
+uint32_t Health_Stalls(void);
+uint8_t Get_Health_Task(int8_t id, health_task_t *out);
 
 // INIT.C
 void Init_Ports(void);
 void Init_UART2(void);
 
 // CONTROL.c
+void Control_Report_Timing(void);
 void Control_Loop(void *args);
 
 
 // GPS.C
 //void Toggle_2(void *args);
 void Read_GPS(void *args);
-int8_t Extract_GPS_Data(char *data, uint16_t start_idx, uint16_t len, gps_data_t *output);
-int8_t Get_GGA_Start(char* array, uint16_t len_to_scan, uint16_t* s_idx_ptr, uint16_t* len_target_str);
-void Clear_Array(char* array, uint16_t len);
-uint8_t Str_2_Int(char* array, uint8_t s_idx, uint8_t len);
+int Read_GPS_Line(char *line, uint16_t max_len);
+uint32_t Get_GPS_Overruns(void);
+void Get_GPS_Data(gps_data_t *out);
+int64_t Get_GPS_Fix_Age_us(void);
+
+// MEMORY.C
+void Memory_Watch_Task(TaskHandle_t task, uint32_t stack_len);
+void Memory_Tasks_Created(void);
+void Memory_Task_Ready(void);
+void Memory_Report(void);
+
+// OTA.C
+void Init_Ota(void);
+void Ota_Control_Check(uint8_t on_time, uint8_t failsafe);
+void Ota_Task(void *args);
+
+// POWER.C
+void Init_Power(void);
+uint8_t Power_Enabled(void);
+void Power_Acquire(uint8_t lock);
+void Power_Release(uint8_t lock);
+void Power_GPS_Hold_Awake(void);
+uint8_t Power_GPS_Burst_Done(void);
+uint16_t Power_Listen_Interval(const laelaps_config_t *cfg);
+void Power_Report(void);
 
 // SERVO.C
 void Init_Servos(void);
 void Set_Servo(uint8_t servo, int16_t position);
-uint16_t Map_Servo_Deg_PWM(int16_t degrees);
+int16_t Get_Servo_Position(uint8_t servo);
+uint16_t Map_Servo_Deg_PWM(uint8_t servo, int16_t degrees);
+uint16_t Map_Servo_Deg_DShot(uint8_t servo, int16_t degrees);
+uint8_t Servo_Is_DShot(uint8_t protocol);
+uint32_t Servo_Period_Ticks(uint8_t protocol);
+
+// TCP_CLIENT.C
+void Init_Tcp_Client(void);
+uint16_t Get_Unit_ID(void);
+void Tcp_Client_Task(void *args);
+int Tcp_Conn_Open(tcp_conn_t *conn, const char *tag, const char *host, uint16_t port, int8_t health_id);
+int Telemetry_Send(uint8_t type, const void *payload, uint16_t len);
+const tcp_conn_t* Get_Telemetry_Conn(void);
+
+// TIME_SYNC.C
+void Init_Time_Sync(void);
+void Time_Sync_On_Sentence(uint32_t utc_ms_of_day, int64_t rx_us, uint16_t line_len);
+void Get_Time_Sync_State(time_sync_state_t *out);
+int64_t Time_Local_To_UTC(int64_t local_us);
+int64_t Time_Now_UTC(void);
+uint8_t Time_Sync_Quality(void);
 
 // WIFI_STA.C
 void Init_Wifi_Sta(void);
+int64_t Wifi_Link_Down_us(void);
 
 #endif
@@ -14,11 +14,16 @@ Last Built With ESP-IDF v5.2.2
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "driver/uart.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "sdkconfig.h"
 #include "gps.h"
+#include "nmea.h"
+#include "power.h"
+#include "config.h"
 #include "functions.h"
 #include "init.h"
 
@@ -28,6 +33,47 @@ Last Built With ESP-IDF v5.2.2
 portMUX_TYPE gps_data_spinlock = portMUX_INITIALIZER_UNLOCKED;
 gps_data_t current_gps_data;
 
+// UART2 event queue, created by Init_UART2
+extern QueueHandle_t gps_uart_queue;
+
+// Global to this file
+// Only written by Read_GPS
+static char gps_line[GPS_LINE_MAX_LEN];
+static nmea_msg_t gps_msg;
+static uint32_t gps_uart_overruns = 0;
+
+
+// GPS_Store_Fix
+// Publishes a GGA fix for the other tasks
+// Returns 1 on success, 0 if the sentence has no UTC time (receiver not ready)
+static uint8_t GPS_Store_Fix(const nmea_gga_t *gga, int64_t rx_time_us){
+    if(!gga->time.valid) return 0;
+
+    // Freezes all other tasks. Use spinlock sparingly
+    portENTER_CRITICAL(&gps_data_spinlock);
+    current_gps_data.lat = gga->lat;
+    current_gps_data.lon = gga->lon;
+    current_gps_data.altitude = gga->altitude;
+    current_gps_data.hdop = gga->hdop;
+    current_gps_data.utc_hour = gga->time.hour;
+    current_gps_data.utc_minute = gga->time.minute;
+    current_gps_data.utc_second = gga->time.second;
+    current_gps_data.utc_millisecond = gga->time.millisecond;
+    current_gps_data.sats = gga->sats;
+    current_gps_data.rx_time_us = rx_time_us;
+    portEXIT_CRITICAL(&gps_data_spinlock);
+    return 1;
+}
+
+// GPS_Store_Course
+// Publishes ground speed and course from RMC or VTG
+static void GPS_Store_Course(float speed_mps, float course_deg){
+    portENTER_CRITICAL(&gps_data_spinlock);
+    current_gps_data.speed_mps = speed_mps;
+    current_gps_data.course_deg = course_deg;
+    portEXIT_CRITICAL(&gps_data_spinlock);
+}
+
 
 
 // EXAMPLE FUNCTION
@@ -43,190 +89,161 @@ gps_data_t current_gps_data;
 //     }
 // }
 
+/*
+Read_GPS
+This task sleeps on the UART2 event queue until the driver sees a '\n'
+Each complete line is read out of the driver ring buffer and parsed
+FIFO / ring buffer overflows drop the buffered data and are counted
+With power management the CPU only runs at max frequency while a line is
+handled, and light sleep is allowed once the burst of the second is over
+*/
 void Read_GPS(void *args){
     // Variables local to this task
     const char *GPS_TAG = "Read_GPS";
-    uint8_t *gps_rx_data = (uint8_t *) malloc(UART2_RX_BUF_LEN);
-    uint8_t len_data_read = 0;
-    uint16_t start_data_idx;
-    uint16_t data_length;
-    int8_t found_data;
-
+    uart_event_t event;
+    int64_t rx_time_us;
+    int line_len;
+    uint32_t gps_baud = Config_Get()->gps_baud;  // Last applied, Init_UART2 set it
+    const laelaps_config_t *cfg;
+    // GPS data wakes the task every second anyway, only idle wakes cost power
+    uint32_t heartbeat_ms = Power_Enabled() ? GPS_HEARTBEAT_PM_MS : GPS_HEARTBEAT_MS;
+    int8_t health_id = Health_Register(heartbeat_ms);
+    uint8_t in_burst = 0;
+
+    Memory_Task_Ready();
+    // Held whenever the task is not blocked, released at the top of the loop
+    Power_Acquire(POWER_LOCK_GPS);
     while(1){
-        // Read from UART2
-        len_data_read = uart_read_bytes(UART_NUM_2, gps_rx_data, UART2_RX_BUF_LEN, pdMS_TO_TICKS(100));
-        if(len_data_read){
-            found_data = Get_GGA_Start((char*)gps_rx_data, len_data_read, &start_data_idx, &data_length);
-            if(found_data){
-                Extract_GPS_Data((char*) gps_rx_data, start_data_idx, data_length, &current_gps_data);
-                GPS_PRINT_DEBUG
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(500));
-    }
-}
-
-/* 
-Extract GPS Data
-This function takes a character array containing NMEA GPS strings, the index to start scanning at,
-the length to scan for, and a pointer to a struct to recieve the output. The function extracts the
-gps data from the string, converts it to floats/ints, and stores in the output struct,
-The function assumes that the gps data is stored in csv strings as per  NMEA standards
-*/
-int8_t Extract_GPS_Data(char *data, uint16_t start_idx, uint16_t len, gps_data_t *output){
-    const char *Ext_GPS_TAG = "Extract_GPS";
-    uint16_t i;
-    uint8_t num_commas = 0;
-    uint8_t gps_str_ptr = 0;
-    char gps_strings[NMEA_FIELDS][NMEA_FIELD_MAX_LEN];
-
-    float lattitude = 0.0;
-    float longitude = 0.0;
-    float altitude;
-    float hdop;
-    uint8_t num_sats;
-    uint8_t utc_min;
-    uint8_t utc_hr;
-    uint8_t utc_sec;
-
-    // Initalize arrays to hold gps data
-    for(i = 0; i < NMEA_FIELDS; i++){
-        Clear_Array(gps_strings[i], NMEA_FIELD_MAX_LEN);
-    }
-
-    // Seperate fields into sub arrays
-    for(i = 0; i < len; i++){
-        if(data[i + start_idx] == ','){
-            num_commas++;
-            gps_str_ptr = 0;
-            
-            // If have found all fields, break from loop. Done scanning
-            if(num_commas >= NMEA_FIELDS){
-                break;
+        // Beat on every wake. The timeout keeps beating without GPS data,
+        // fix loss is the failsafe's job, not the watchdog's
+        Health_Beat(health_id);
+        Power_Release(POWER_LOCK_GPS);
+        if(xQueueReceive(gps_uart_queue, &event, pdMS_TO_TICKS(in_burst ? POWER_GPS_IDLE_MS : heartbeat_ms)) != pdTRUE){
+            // Line gap after a burst, nothing more until the next second
+            if(in_burst){
+                in_burst = 0;
+                Power_GPS_Burst_Done();
             }
+            Power_Acquire(POWER_LOCK_GPS);
             continue;
         }
+        // Timestamp as close to the '\n' interrupt as possible
+        rx_time_us = esp_timer_get_time();
+        Power_Acquire(POWER_LOCK_GPS);
+        in_burst = Power_Enabled();
+
+        // Apply a changed baud rate without reinstalling the driver
+        // Only on a change, reprogramming the UART can cut a sentence in progress
+        cfg = Config_Get();
+        if(cfg->gps_baud != gps_baud){
+            gps_baud = cfg->gps_baud;
+            uart_set_baudrate(UART_NUM_2, gps_baud);
+        }
 
-        if(num_commas < NMEA_FIELDS){
-            gps_strings[num_commas][gps_str_ptr] = data[i + start_idx];
-            gps_str_ptr++;  
+        switch(event.type){
+        case UART_PATTERN_DET:
+            line_len = Read_GPS_Line(gps_line, GPS_LINE_MAX_LEN);
+            if(line_len <= 0) break;
+
+            // Only GGA carries the fix, and its timestamp feeds the time sync
+            switch(Nmea_Parse_Line(gps_line, (uint16_t) line_len, &gps_msg)){
+            case NMEA_MSG_GGA:
+                if(GPS_Store_Fix(&gps_msg.gga, rx_time_us)){
+                    Time_Sync_On_Sentence(GPS_UTC_MS_OF_DAY(current_gps_data), rx_time_us, (uint16_t) line_len);
+                    GPS_PRINT_DEBUG
+                }
+            break;
+
+            case NMEA_MSG_RMC:
+                if(gps_msg.rmc.status == 'A') GPS_Store_Course(gps_msg.rmc.speed_knots * GPS_KNOTS_TO_MPS, gps_msg.rmc.course_deg);
+            break;
+
+            case NMEA_MSG_VTG:
+                GPS_Store_Course(gps_msg.vtg.speed_kmh * GPS_KMH_TO_MPS, gps_msg.vtg.course_deg);
+            break;
+
+            default:
+            break;
+            }
+        break;
+
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // Data is already lost. Drop everything so the next line starts clean
+            gps_uart_overruns++;
+            ESP_LOGW(GPS_TAG, "UART overrun (%lu)", (unsigned long) gps_uart_overruns);
+            uart_flush_input(UART_NUM_2);
+            uart_pattern_queue_reset(UART_NUM_2, GPS_PATTERN_QUEUE_LEN);
+            xQueueReset(gps_uart_queue);
+        break;
+
+        default:
+        break;
         }
     }
-
-    // Convert from strings to ints or floats
-    utc_hr = Str_2_Int(gps_strings[0], 0, 2);
-    utc_min = Str_2_Int(gps_strings[0], 2, 2);
-    utc_sec = Str_2_Int(gps_strings[0], 4, 2);
-
-    lattitude += Str_2_Int(gps_strings[1], 0, 2);
-    lattitude += (atof(&gps_strings[1][2])) / 60;
-    if(gps_strings[2][0] == 'S') lattitude *= -1;
-
-    longitude += Str_2_Int(gps_strings[3], 0, 3);
-    longitude += (atof(&gps_strings[3][3])) / 60;
-    if(gps_strings[4][0] == 'W') longitude *= -1;
-
-    num_sats = Str_2_Int(gps_strings[6], 0, 2);
-    hdop = atof(gps_strings[7]);
-    altitude = atof(gps_strings[8]);
-
-    // Write data to global variable for use by other tasks
-    // Freezes all other tasks. Use spinlock sparingly
-    portENTER_CRITICAL(&gps_data_spinlock);
-    current_gps_data.lat = lattitude;
-    current_gps_data.lon = longitude;
-    current_gps_data.altitude = altitude;
-    current_gps_data.hdop = hdop;
-    current_gps_data.utc_hour = utc_hr;
-    current_gps_data.utc_minute = utc_min;
-    current_gps_data.utc_second = utc_sec;
-    current_gps_data.sats = num_sats;
-    portEXIT_CRITICAL(&gps_data_spinlock);
-
-    return 1;
 }
 
 /*
-Get_GGA_Start
-This function scans an array for the presence of the string "$GPGGA ... \n"
-Upon finding the string, the function outputs the index of the first comma, and the
-length until a new line character. The function takes a pointer to an array, the 
-length of the array and pointers to the two values to hold the output indexes
-Returns 1 on success, 0 on fail to find string
+Read_GPS_Line
+This function reads one '\n' terminated line out of the UART2 ring buffer
+The bytes are already buffered when the pattern event arrives, so it does not wait
+Lines longer than max_len are read and dropped
+Returns the line length including '\n', 0 if the line was dropped, -1 on error
 */
-int8_t Get_GGA_Start(char* array, uint16_t len_to_scan, uint16_t* s_idx_ptr, uint16_t* len_target_str){
-    uint16_t i;
-    uint8_t found_start = FALSE;
-    uint8_t cmp_str_idx = 0;
-    char cmp_str[7] = "$GPGGA,";
-    const char *GGA_Start_TAG = "GGA_Start";
-
-    for(i = 0; i < len_to_scan; i++){
-        // If match, move to checking for the next character
-        if(array[i] == cmp_str[cmp_str_idx]){
-            cmp_str_idx++;
-        }
-        else{
-            cmp_str_idx = 0;
-        }
-
-        // If whole string matched, set flag, save current index
-        if(cmp_str_idx >= 7){
-            cmp_str_idx = 0;
-            found_start = TRUE;
-            *s_idx_ptr = i + 1;         // +1 gives 1st character of data rather than end of "$GPGGA," string
-
-            // DEBUG
-            //ESP_LOGI(GGA_Start_TAG, "Found Start, %u", *s_idx_ptr);
-        }
-
-        // Once found start, save index of next new line character
-        if(found_start && (array[i] == '\n')){
-            *len_target_str = i - *s_idx_ptr;
+int Read_GPS_Line(char *line, uint16_t max_len){
+    int pos = uart_pattern_pop_pos(UART_NUM_2);
+    int len;
+    int chunk;
+
+    // Pattern position queue overflowed, positions no longer match the buffer
+    if(pos < 0){
+        gps_uart_overruns++;
+        uart_flush_input(UART_NUM_2);
+        uart_pattern_queue_reset(UART_NUM_2, GPS_PATTERN_QUEUE_LEN);
+        return -1;
+    }
 
-            // DEBUG
-            //ESP_LOGI(GGA_Start_TAG, "Found End, %u", *len_target_str);
-            return TRUE;
-        }
+    len = pos + 1;
+    if(len <= max_len){
+        return uart_read_bytes(UART_NUM_2, line, len, 0);
     }
 
-    // If exited for loop without finding string, return false
-    return FALSE;
+    // Too long to be NMEA, discard in max_len chunks
+    while(len > 0){
+        chunk = (len > max_len) ? max_len : len;
+        if(uart_read_bytes(UART_NUM_2, line, chunk, 0) <= 0) break;
+        len -= chunk;
+    }
+    return 0;
 }
 
-
 /*
-Clear_Array
-This function sets the contents of a character array to all zeros
-Takes pointer to array, and array length. Does not return anything
+Get_GPS_Overruns
+Returns the number of UART overruns seen since boot
 */
-void Clear_Array(char* array, uint16_t len){
-    uint16_t i;
-    for(i = 0; i < len; i++){
-        array[i] = '\0';
-    }
-    return;
+uint32_t Get_GPS_Overruns(void){
+    return gps_uart_overruns;
 }
 
 /*
-Str_2_Int
-This function takes a pointer to a character array, an index to a starting point in that array,
-and a length to read. It then reads the specified number of characters and converts to an unsigned
-integer. If the specified characters are not numeric, function returns 0. Number must be less than 256
+Get_GPS_Data
+Copies the latest GPS data for use by other tasks
 */
-uint8_t Str_2_Int(char* array, uint8_t s_idx, uint8_t len){
-    uint8_t i;
-    uint8_t output = 0;
-    for(i = 0; i < len; i++){
-        // Validate data
-        if((array[s_idx + i] < '0') || (array[s_idx + i] > '9')){
-            output = 0;
-            return output;
-        }
+void Get_GPS_Data(gps_data_t *out){
+    portENTER_CRITICAL(&gps_data_spinlock);
+    *out = current_gps_data;
+    portEXIT_CRITICAL(&gps_data_spinlock);
+}
 
-        // If data good, convert to int
-        output *= 10;
-        output += array[s_idx + i] - ASCII_OFFSET;
-    }
-    return output;
-}
\ No newline at end of file
+/*
+Get_GPS_Fix_Age_us
+Returns microseconds since the latest sentence with data arrived, -1 if none yet
+*/
+int64_t Get_GPS_Fix_Age_us(void){
+    int64_t rx_time_us;
+    portENTER_CRITICAL(&gps_data_spinlock);
+    rx_time_us = current_gps_data.rx_time_us;
+    portEXIT_CRITICAL(&gps_data_spinlock);
+    if(rx_time_us == 0) return -1;
+    return esp_timer_get_time() - rx_time_us;
+}
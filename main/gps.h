@@ -17,17 +17,24 @@ Last Built With ESP-IDF v5.2.2
 
 // Print debut info
 #ifdef GPS_DEBUG
-#define GPS_PRINT_DEBUG ESP_LOGI(GPS_TAG, "UTC Time: %d:%d:%d", current_gps_data.utc_hour, current_gps_data.utc_minute, current_gps_data.utc_second); ESP_LOGI(GPS_TAG, "Lattitude: %.5f", current_gps_data.lat); ESP_LOGI(GPS_TAG, "Longitude: %.5f", current_gps_data.lon); ESP_LOGI(GPS_TAG, "Altitude: %.1f", current_gps_data.altitude); ESP_LOGI(GPS_TAG, "# Sats: %d", current_gps_data.sats); ESP_LOGI(GPS_TAG, "HDOP: %.2f", current_gps_data.hdop); ESP_LOGI(GPS_TAG, "Stack High Water: %d", uxTaskGetStackHighWaterMark(NULL));
+#define GPS_PRINT_DEBUG ESP_LOGI(GPS_TAG, "UTC Time: %d:%d:%d.%03d", current_gps_data.utc_hour, current_gps_data.utc_minute, current_gps_data.utc_second, current_gps_data.utc_millisecond); ESP_LOGI(GPS_TAG, "Lattitude: %.5f", current_gps_data.lat); ESP_LOGI(GPS_TAG, "Longitude: %.5f", current_gps_data.lon); ESP_LOGI(GPS_TAG, "Altitude: %.1f", current_gps_data.altitude); ESP_LOGI(GPS_TAG, "# Sats: %d", current_gps_data.sats); ESP_LOGI(GPS_TAG, "HDOP: %.2f", current_gps_data.hdop); ESP_LOGI(GPS_TAG, "Stack High Water: %d", uxTaskGetStackHighWaterMark(NULL));
 #elif
 #define GPS_PRINT_DEBUG
 #endif
 
 // Macros
-#define NMEA_FIELD_MAX_LEN  12
-#define NMEA_FIELDS         9
 #define UART2_RX_BUF_LEN    1024
 #define UART2_TX_BUF_LEN    0
-#define ASCII_OFFSET        0x30
+#define UART2_EVENT_QUEUE_LEN   20
+#define GPS_PATTERN_QUEUE_LEN   16
+#define GPS_HEARTBEAT_MS    500                 // Read_GPS wakes at least this often to feed the watchdog
+#define GPS_HEARTBEAT_PM_MS 1500                // Same with power management, longer than the NMEA burst period
+#define GPS_LINE_MAX_LEN    128                 // NMEA limit is 82, leave room for proprietary sentences
+#define GPS_UART_BAUD       9600
+#define GPS_UART_TX_PIN     17
+#define GPS_UART_RX_PIN     16
+#define GPS_KNOTS_TO_MPS    0.514444f
+#define GPS_KMH_TO_MPS      (1.0f / 3.6f)
 
 #define TRUE                1
 #define FALSE               0
@@ -44,15 +51,12 @@ typedef struct GPS_Data{
     uint8_t utc_minute;
     uint8_t utc_second;
     uint8_t sats;
+    uint16_t utc_millisecond;
+    float speed_mps;                            // Ground speed and course, from RMC or VTG
+    float course_deg;
+    int64_t rx_time_us;                         // esp_timer time the sentence arrived
 } gps_data_t;
 
-// Struct to hold char strings from nmea messages
-typedef struct NMEA_Fields{
-    char lat_str[NMEA_FIELD_MAX_LEN];
-    char lon_str[NMEA_FIELD_MAX_LEN];
-    char acc_str[NMEA_FIELD_MAX_LEN];
-    char alt_str[NMEA_FIELD_MAX_LEN];
-    char sat_str[NMEA_FIELD_MAX_LEN];
-    char utc_str[NMEA_FIELD_MAX_LEN];
-} nmea_fields_t;
-#endif
\ No newline at end of file
+// UTC milliseconds of day of a gps_data_t
+#define GPS_UTC_MS_OF_DAY(d) ((((uint32_t) (d).utc_hour * 60 + (d).utc_minute) * 60 + (d).utc_second) * 1000 + (d).utc_millisecond)
+#endif
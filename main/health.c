@@ -0,0 +1,250 @@
+/*
+This file holds the source code for task health monitoring
+Each task registers with an expected period and calls Health_Beat once
+per iteration. A beat also feeds the ESP-IDF task watchdog for that task
+Late beats are counted as deadline misses, and a periodic monitor flags
+tasks that stopped beating entirely. The latest miss is kept in RTC
+memory so it can be reported after a watchdog reset
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "health.h"
+#include "functions.h"
+
+_Static_assert(HEALTH_PERIOD_MAX_MS + HEALTH_PERIOD_MAX_MS / HEALTH_SLACK_DIV < HEALTH_TWDT_TIMEOUT_MS,
+               "A task at the longest period would trip the task watchdog before its miss is recorded");
+
+
+// Global to this file
+// USE SPINLOCK, the monitor and the TWDT ISR read what tasks write
+static portMUX_TYPE health_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static health_task_t health_tasks[HEALTH_MAX_TASKS];
+static uint8_t health_num_tasks = 0;
+static uint32_t health_stalls = 0;              // Since boot, counted by the monitor
+static RTC_NOINIT_ATTR health_record_t health_record;
+static esp_timer_handle_t health_timer = NULL;
+static const char* HEALTH_TAG = "Health";
+
+
+// Health_Record_Miss
+// Saves a deadline miss in the RTC record. Call with health_spinlock held
+static void Health_Record_Miss(const health_task_t *t, int64_t late_us, int64_t now_us){
+    strncpy(health_record.task_name, t->name, HEALTH_NAME_LEN);
+    health_record.late_us = late_us;
+    health_record.time_us = now_us;
+    health_record.total_misses++;
+}
+
+
+// Health_Monitor
+// esp_timer callback. Flags tasks that have not beaten for longer than their deadline
+static void Health_Monitor(void *args){
+    int64_t now = esp_timer_get_time();
+    int64_t late;
+    health_task_t *t;
+    uint8_t i;
+
+    for(i = 0; i < health_num_tasks; i++){
+        t = &health_tasks[i];
+        portENTER_CRITICAL(&health_spinlock);
+        late = now - t->last_beat_us - t->period_us;
+        if((late > t->period_us / HEALTH_SLACK_DIV) && !t->stalled){
+            t->stalled = 1;
+            health_stalls++;
+            Health_Record_Miss(t, late, now);
+        }
+        else{
+            late = 0;
+        }
+        portEXIT_CRITICAL(&health_spinlock);
+
+        if(late){
+            ESP_LOGW(HEALTH_TAG, "%s stalled, %lld us past deadline", t->name, (long long) late);
+        }
+    }
+}
+
+
+// esp_task_wdt_isr_user_handler
+// Called by ESP-IDF from the task watchdog ISR, just before the panic
+// Records which registered task is furthest behind
+void esp_task_wdt_isr_user_handler(void){
+    int64_t now = esp_timer_get_time();
+    int64_t late;
+    int64_t worst_late = INT64_MIN;
+    uint8_t worst = 0;
+    uint8_t i;
+
+    portENTER_CRITICAL_ISR(&health_spinlock);
+    for(i = 0; i < health_num_tasks; i++){
+        late = now - health_tasks[i].last_beat_us - health_tasks[i].period_us;
+        if(late > worst_late){
+            worst_late = late;
+            worst = i;
+        }
+    }
+    if(health_num_tasks){
+        Health_Record_Miss(&health_tasks[worst], worst_late, now);
+    }
+    health_record.twdt_fired = 1;
+    portEXIT_CRITICAL_ISR(&health_spinlock);
+}
+
+
+// Init_Health
+// Reports the post-mortem record of the previous run, then starts the
+// task watchdog and the stall monitor
+void Init_Health(void){
+    esp_reset_reason_t reason = esp_reset_reason();
+    esp_err_t err;
+
+    // RTC_NOINIT memory is garbage after power on, only trust it with the magic
+    if((reason == ESP_RST_POWERON) || (health_record.magic != HEALTH_RECORD_MAGIC)){
+        memset(&health_record, 0, sizeof(health_record_t));
+        health_record.magic = HEALTH_RECORD_MAGIC;
+    }
+    else if(health_record.total_misses || health_record.twdt_fired){
+        health_record.task_name[HEALTH_NAME_LEN - 1] = '\0';
+        ESP_LOGW(HEALTH_TAG, "Previous run (reset reason %d, watchdog %s): %lu deadline misses, last by %s, %lld us late at %lld us",
+                 reason, health_record.twdt_fired ? "fired" : "quiet", (unsigned long) health_record.total_misses,
+                 health_record.task_name, (long long) health_record.late_us, (long long) health_record.time_us);
+    }
+    health_record.boot_count++;
+    health_record.twdt_fired = 0;
+    health_record.total_misses = 0;
+    health_record.task_name[0] = '\0';
+
+    // TWDT is normally started by ESP-IDF already, reconfigure it then
+    esp_task_wdt_config_t twdt_config = {
+        .timeout_ms = HEALTH_TWDT_TIMEOUT_MS,
+        .idle_core_mask = (1 << portNUM_PROCESSORS) - 1,
+        .trigger_panic = true,
+    };
+    err = esp_task_wdt_init(&twdt_config);
+    if(err == ESP_ERR_INVALID_STATE){
+        err = esp_task_wdt_reconfigure(&twdt_config);
+    }
+    ESP_ERROR_CHECK(err);
+
+    esp_timer_create_args_t health_timer_args = {
+        .callback = Health_Monitor,
+        .name = "health",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&health_timer_args, &health_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(health_timer, HEALTH_CHECK_PERIOD_MS * 1000));
+}
+
+
+// Health_Register
+// Registers the calling task with the health monitor and the task watchdog
+// Takes the expected time between beats in ms, at most HEALTH_PERIOD_MAX_MS
+// Returns an id for Health_Beat, -1 if the table is full or the period too long
+int8_t Health_Register(uint32_t period_ms){
+    health_task_t *t;
+    int8_t id;
+
+    if(period_ms > HEALTH_PERIOD_MAX_MS){
+        ESP_LOGE(HEALTH_TAG, "%s period %lu ms is over %d ms, not registered", pcTaskGetName(NULL),
+                 (unsigned long) period_ms, HEALTH_PERIOD_MAX_MS);
+        return -1;
+    }
+    portENTER_CRITICAL(&health_spinlock);
+    if(health_num_tasks >= HEALTH_MAX_TASKS){
+        portEXIT_CRITICAL(&health_spinlock);
+        ESP_LOGE(HEALTH_TAG, "Task table full");
+        return -1;
+    }
+    id = health_num_tasks;
+    t = &health_tasks[id];
+    memset(t, 0, sizeof(health_task_t));
+    strncpy(t->name, pcTaskGetName(NULL), HEALTH_NAME_LEN - 1);
+    t->period_us = period_ms * 1000;
+    t->last_beat_us = esp_timer_get_time();
+    health_num_tasks++;
+    portEXIT_CRITICAL(&health_spinlock);
+
+    ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+    return id;
+}
+
+
+// Health_Set_Period
+// Changes the expected period of a registered task
+// A period over HEALTH_PERIOD_MAX_MS is refused, the old one stays
+void Health_Set_Period(int8_t id, uint32_t period_ms){
+    if((id < 0) || (id >= health_num_tasks)) return;
+    if(period_ms > HEALTH_PERIOD_MAX_MS){
+        ESP_LOGE(HEALTH_TAG, "Period %lu ms is over %d ms, kept the old one", (unsigned long) period_ms, HEALTH_PERIOD_MAX_MS);
+        return;
+    }
+    portENTER_CRITICAL(&health_spinlock);
+    health_tasks[id].period_us = period_ms * 1000;
+    portEXIT_CRITICAL(&health_spinlock);
+}
+
+
+// Health_Beat
+// Called once per iteration by a registered task. Feeds the task watchdog
+// and counts the beat as a deadline miss if it came late
+void Health_Beat(int8_t id){
+    int64_t now = esp_timer_get_time();
+    health_task_t *t;
+    int64_t late;
+
+    if((id < 0) || (id >= health_num_tasks)) return;
+    t = &health_tasks[id];
+
+    portENTER_CRITICAL(&health_spinlock);
+    late = now - t->last_beat_us - t->period_us;
+    if(late > t->period_us / HEALTH_SLACK_DIV){
+        t->misses++;
+        if(late > t->worst_late_us) t->worst_late_us = late;
+        // Stalls were already recorded by the monitor
+        if(!t->stalled) Health_Record_Miss(t, late, now);
+    }
+    t->stalled = 0;
+    t->last_beat_us = now;
+    t->beats++;
+    portEXIT_CRITICAL(&health_spinlock);
+
+    esp_task_wdt_reset();
+}
+
+
+// Health_Stalls
+// Returns how many times the monitor found a task stalled since boot
+uint32_t Health_Stalls(void){
+    uint32_t stalls;
+
+    portENTER_CRITICAL(&health_spinlock);
+    stalls = health_stalls;
+    portEXIT_CRITICAL(&health_spinlock);
+    return stalls;
+}
+
+
+// Get_Health_Task
+// Copies the bookkeeping of one task. Returns 0 if the id is invalid
+uint8_t Get_Health_Task(int8_t id, health_task_t *out){
+    if((id < 0) || (id >= health_num_tasks)) return 0;
+    portENTER_CRITICAL(&health_spinlock);
+    *out = health_tasks[id];
+    portEXIT_CRITICAL(&health_spinlock);
+    return 1;
+}
@@ -0,0 +1,55 @@
+/*
+This file holds the macro definitions and types for health.c
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#define HEALTH_MAX_TASKS        8
+#define HEALTH_NAME_LEN         16
+
+// Task watchdog resets the chip if a registered task stops beating for this long
+// Must be longer than the longest task period, and than TCP_RESOLVE_MAX_MS,
+// the longest a task blocks without beating (checked in tcp_client.c)
+#define HEALTH_TWDT_TIMEOUT_MS  8000
+// Longest period a task may register, its deadline plus slack stays well inside the timeout
+#define HEALTH_PERIOD_MAX_MS    4000
+// How often the monitor checks for tasks that stopped beating
+#define HEALTH_CHECK_PERIOD_MS  100
+// A beat later than period + period / HEALTH_SLACK_DIV is a deadline miss
+#define HEALTH_SLACK_DIV        2
+
+// Marks health_record as valid after a reset
+#define HEALTH_RECORD_MAGIC     0x4C334844
+
+
+// Custom data types
+// Heartbeat bookkeeping for one task
+typedef struct Health_Task{
+    char name[HEALTH_NAME_LEN];
+    uint32_t period_us;
+    int64_t last_beat_us;
+    uint32_t beats;
+    uint32_t misses;
+    int64_t worst_late_us;
+    uint8_t stalled;                            // Set by the monitor, cleared on the next beat
+} health_task_t;
+
+// Post-mortem record, kept in RTC memory across a reset
+typedef struct Health_Record{
+    uint32_t magic;
+    uint32_t boot_count;
+    char task_name[HEALTH_NAME_LEN];            // Task with the latest deadline miss
+    int64_t late_us;                            // How late it was
+    int64_t time_us;                            // esp_timer time of the miss
+    uint32_t total_misses;
+    uint8_t twdt_fired;                         // Task watchdog triggered the reset
+} health_record_t;
+
+#endif
@@ -13,6 +13,7 @@ Last Built With ESP-IDF v5.2.2
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "driver/uart.h"
 #include "driver/mcpwm_prelude.h"
@@ -20,9 +21,14 @@ Last Built With ESP-IDF v5.2.2
 #include "sdkconfig.h"
 #include "init.h"
 #include "gps.h"
+#include "config.h"
 #include "functions.h"
 
 
+// UART2 event queue, read by Read_GPS
+QueueHandle_t gps_uart_queue = NULL;
+
+
 // Init_Ports
 void Init_Ports(void){
     gpio_reset_pin(LED1_PIN);
@@ -33,9 +39,11 @@ void Init_Ports(void){
 
 // Init UART2
 // Used to read GPS
+// Installs the driver with an event queue and '\n' pattern detection
+// so Read_GPS only wakes when a full NMEA sentence is buffered
 void Init_UART2(void){
     uart_config_t uart2_config_params = {
-        .baud_rate  = 9600,
+        .baud_rate  = Config_Get()->gps_baud,
         .data_bits  = UART_DATA_8_BITS,
         .parity     = UART_PARITY_DISABLE,
         .stop_bits  = UART_STOP_BITS_1,
@@ -43,10 +51,19 @@ void Init_UART2(void){
         .source_clk = UART_SCLK_DEFAULT
     };
 
+    // APB changes with DFS and the driver would pin it at max with a PM lock
+    // REF_TICK stays at 1 MHz, plenty for NMEA baud rates
+    if(Power_Enabled()){
+        uart2_config_params.source_clk = UART_SCLK_REF_TICK;
+    }
+
     // Set parameters
     ESP_ERROR_CHECK(uart_param_config(UART_NUM_2, &uart2_config_params));
     // Set UART2 Rx to GPIO 16 and TX to 17. These are the default pins for UART2
-    ESP_ERROR_CHECK(uart_set_pin(UART_NUM_2, 17, 16, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK(uart_set_pin(UART_NUM_2, GPS_UART_TX_PIN, GPS_UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
     // Install resources and drivers
-    ESP_ERROR_CHECK(uart_driver_install(UART_NUM_2, UART2_RX_BUF_LEN, UART2_TX_BUF_LEN, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_driver_install(UART_NUM_2, UART2_RX_BUF_LEN, UART2_TX_BUF_LEN, UART2_EVENT_QUEUE_LEN, &gps_uart_queue, 0));
+    // Raise UART_PATTERN_DET on every '\n'
+    ESP_ERROR_CHECK(uart_enable_pattern_det_baud_intr(UART_NUM_2, '\n', 1, 9, 0, 0));
+    ESP_ERROR_CHECK(uart_pattern_queue_reset(UART_NUM_2, GPS_PATTERN_QUEUE_LEN));
 }
\ No newline at end of file
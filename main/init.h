@@ -13,7 +13,7 @@ Last Built With ESP-IDF v5.2.2
 
 #define LED1_PIN    5
 #define LED1_RATE   900
-#define LED2_PIN    14
+#define LED2_PIN    4
 #define LED2_RATE   800
 
 #define UART
@@ -12,12 +12,25 @@ It will initalize the system, spawn threads, and then exit
 #include "nvs_flash.h"
 #include "sdkconfig.h"
 #include "main.h"
+#include "memory.h"
 #include "functions.h"
 
 
 //TaskHandle_t xToggle2_Handle = NULL;
 TaskHandle_t xRead_GPS_Handle = NULL;
 TaskHandle_t xControl_Loop = NULL;
+TaskHandle_t xTcp_Client_Handle = NULL;
+TaskHandle_t xOta_Handle = NULL;
+
+// Task stacks and control blocks, static so nothing is left on the heap to fragment
+static StackType_t xRead_GPS_Stack[MEMORY_STACK_GPS];
+static StackType_t xControl_Loop_Stack[MEMORY_STACK_CONTROL];
+static StackType_t xTcp_Client_Stack[MEMORY_STACK_TCP];
+static StackType_t xOta_Stack[MEMORY_STACK_OTA];
+static StaticTask_t xRead_GPS_TCB;
+static StaticTask_t xControl_Loop_TCB;
+static StaticTask_t xTcp_Client_TCB;
+static StaticTask_t xOta_TCB;
 
 
 void app_main(void){
@@ -29,18 +42,36 @@ void app_main(void){
     }
     ESP_ERROR_CHECK(ret);
 
-
+    // Load configuration. Everything below reads from it
+    Config_Init();
+    // Report why the last run ended, then start watching tasks
+    Init_Health();
+    // DFS and light sleep. Before the UART, its clock source depends on it
+    Init_Power();
 
     // INIT ALL
     Init_Ports();
     Init_UART2();
+    Init_Time_Sync();
     Init_Servos();
     Init_Wifi_Sta();
+    Init_Tcp_Client();
+    // Starts the trial of a newly installed image. Before the control loop runs
+    Init_Ota();
 
     // Start Tasks
     //xTaskCreate(Toggle_2, "Toggle_2", 4096, NULL, 1, &xToggle2_Handle);
-    xTaskCreate(Read_GPS, "Read_GPS", 4096, NULL, 2, &xRead_GPS_Handle); // Using about 2k stack space
-    xTaskCreate(Control_Loop, "Control Loop", 4096, NULL, 3, &xControl_Loop);
+    // Stack depth is in bytes on ESP-IDF, StackType_t is uint8_t
+    xRead_GPS_Handle = xTaskCreateStatic(Read_GPS, "Read_GPS", MEMORY_STACK_GPS, NULL, 2, xRead_GPS_Stack, &xRead_GPS_TCB);
+    xControl_Loop = xTaskCreateStatic(Control_Loop, "Control Loop", MEMORY_STACK_CONTROL, NULL, 3, xControl_Loop_Stack, &xControl_Loop_TCB);
+    xTcp_Client_Handle = xTaskCreateStatic(Tcp_Client_Task, "Tcp_Client", MEMORY_STACK_TCP, NULL, 1, xTcp_Client_Stack, &xTcp_Client_TCB); // Lowest, telemetry never delays control
+    xOta_Handle = xTaskCreateStatic(Ota_Task, "Ota", MEMORY_STACK_OTA, NULL, 1, xOta_Stack, &xOta_TCB);
+    Memory_Watch_Task(xRead_GPS_Handle, MEMORY_STACK_GPS);
+    Memory_Watch_Task(xControl_Loop, MEMORY_STACK_CONTROL);
+    Memory_Watch_Task(xTcp_Client_Handle, MEMORY_STACK_TCP);
+    Memory_Watch_Task(xOta_Handle, MEMORY_STACK_OTA);
+    // Heap allocations are counted from here on, once each task finished its set up
+    Memory_Tasks_Created();
 
     // Done with app_main. Main task will self delete
     return;
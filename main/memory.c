@@ -0,0 +1,160 @@
+/*
+This file holds the source code for the RAM report
+All application buffers and task stacks are static, so after boot only
+ESP-IDF (Wi-Fi, lwIP, NVS) should allocate from the heap. A heap hook
+counts every allocation after boot by the task that made it, so the
+report shows which tasks still touch the heap and how fragmented the
+internal heap Wi-Fi and lwIP share has become
+RAM per source file is reported at build time by `idf.py size-files`
+The report walks the heap under its lock, so the OTA task prints it
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "memory.h"
+#include "functions.h"
+
+_Static_assert(MEMORY_STACK_GPS + MEMORY_STACK_CONTROL + MEMORY_STACK_TCP + MEMORY_STACK_OTA <= MEMORY_STACK_BUDGET,
+               "Task stacks over budget");
+
+// Linker script symbols, bounds of the static RAM sections
+extern uint8_t _data_start, _data_end, _bss_start, _bss_end;
+
+
+// Global to this file
+// The table is filled at boot, before counting starts, and only read by the hook after
+static memory_task_t memory_tasks[MEMORY_MAX_TASKS];
+static memory_task_t memory_other = { .name = "other" }; // ESP-IDF tasks and ISRs
+static uint8_t memory_num_tasks = 0;
+static uint8_t memory_num_ready = 0;
+static uint8_t memory_all_created = 0;
+static volatile uint8_t memory_counting = 0;
+static portMUX_TYPE memory_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static const char* MEM_TAG = "Memory";
+
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+// esp_heap_trace_alloc_hook
+// Called by the heap on every allocation, from any task or ISR and maybe with
+// the flash cache off, so IRAM and nothing but a table scan
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps){
+    memory_task_t *t = &memory_other;
+    TaskHandle_t task;
+    uint8_t i;
+
+    if(!memory_counting) return;
+    if(!xPortInIsrContext()){
+        task = xTaskGetCurrentTaskHandle();
+        for(i = 0; i < memory_num_tasks; i++){
+            if(memory_tasks[i].handle == task){
+                t = &memory_tasks[i];
+                break;
+            }
+        }
+    }
+    __atomic_fetch_add(&t->allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&t->alloc_bytes, (uint32_t) size, __ATOMIC_RELAXED);
+}
+#endif
+
+
+// Memory_Check_Boot_Done
+// Starts counting once every task is created and has finished its own set up
+// Must be called with memory_spinlock held
+static void Memory_Check_Boot_Done(void){
+    if(memory_all_created && (memory_num_ready >= memory_num_tasks)) memory_counting = 1;
+}
+
+
+// Memory_Watch_Task
+// Adds a statically created task to the report
+// Takes its handle and stack size in bytes
+void Memory_Watch_Task(TaskHandle_t task, uint32_t stack_len){
+    memory_task_t *t;
+
+    portENTER_CRITICAL(&memory_spinlock);
+    if(memory_num_tasks >= MEMORY_MAX_TASKS){
+        portEXIT_CRITICAL(&memory_spinlock);
+        ESP_LOGE(MEM_TAG, "Task table full");
+        return;
+    }
+    t = &memory_tasks[memory_num_tasks];
+    t->handle = task;
+    strncpy(t->name, pcTaskGetName(task), MEMORY_NAME_LEN - 1);
+    t->stack_len = stack_len;
+    memory_num_tasks++;
+    portEXIT_CRITICAL(&memory_spinlock);
+}
+
+
+// Memory_Tasks_Created
+// Called by app_main once every task is created and watched
+void Memory_Tasks_Created(void){
+    portENTER_CRITICAL(&memory_spinlock);
+    memory_all_created = 1;
+    Memory_Check_Boot_Done();
+    portEXIT_CRITICAL(&memory_spinlock);
+}
+
+
+// Memory_Task_Ready
+// Called by each watched task right before its loop
+// Its set up may allocate (watchdog entry, timers), its loop should not
+void Memory_Task_Ready(void){
+    portENTER_CRITICAL(&memory_spinlock);
+    memory_num_ready++;
+    Memory_Check_Boot_Done();
+    portEXIT_CRITICAL(&memory_spinlock);
+}
+
+
+// Memory_Report
+// Prints static RAM, internal heap use and fragmentation, and per task
+// unused stack and heap allocations since boot
+// Walks the heap under its lock, keep it out of timed code
+void Memory_Report(void){
+    multi_heap_info_t heap;
+    memory_task_t *t;
+    uint32_t unused;
+    uint32_t needed;
+    uint32_t fragmented = 0;
+    uint8_t i;
+
+    heap_caps_get_info(&heap, MALLOC_CAP_INTERNAL);
+    if(heap.total_free_bytes) fragmented = 100 - (uint32_t) ((uint64_t) heap.largest_free_block * 100 / heap.total_free_bytes);
+    ESP_LOGI(MEM_TAG, ".data %u .bss %u bytes, internal heap %u of %u free, largest block %u (%lu%% fragmented), lowest %u",
+             (unsigned) (&_data_end - &_data_start), (unsigned) (&_bss_end - &_bss_start),
+             (unsigned) heap.total_free_bytes, (unsigned) heap_caps_get_total_size(MALLOC_CAP_INTERNAL),
+             (unsigned) heap.largest_free_block, (unsigned long) fragmented, (unsigned) heap.minimum_free_bytes);
+    if(!memory_counting){
+        ESP_LOGI(MEM_TAG, "Still booting, allocations not counted yet");
+    }
+
+    for(i = 0; i < memory_num_tasks; i++){
+        t = &memory_tasks[i];
+        // Bytes on ESP-IDF, StackType_t is uint8_t
+        unused = uxTaskGetStackHighWaterMark2(t->handle);
+        needed = (t->stack_len - unused + MEMORY_STACK_LOW + MEMORY_STACK_ROUND - 1) / MEMORY_STACK_ROUND * MEMORY_STACK_ROUND;
+        if(unused < MEMORY_STACK_LOW){
+            ESP_LOGW(MEM_TAG, "%s stack %lu, only %lu unused", t->name, (unsigned long) t->stack_len, (unsigned long) unused);
+        }
+        ESP_LOGI(MEM_TAG, "%-12s stack %5lu, %5lu unused (size %5lu), %lu heap allocs (%lu bytes) since boot", t->name,
+                 (unsigned long) t->stack_len, (unsigned long) unused, (unsigned long) needed,
+                 (unsigned long) t->allocs, (unsigned long) t->alloc_bytes);
+    }
+    ESP_LOGI(MEM_TAG, "%-12s %lu heap allocs (%lu bytes) since boot", memory_other.name,
+             (unsigned long) memory_other.allocs, (unsigned long) memory_other.alloc_bytes);
+}
@@ -0,0 +1,47 @@
+/*
+This file holds the macro definitions and types for memory.c
+The allocation counts need CONFIG_HEAP_USE_HOOKS in sdkconfig, see
+sdkconfig.defaults. Without it the report only shows heap and stack use
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdint.h>
+
+// Task stacks in bytes, allocated statically in main.c
+// Memory_Report prints the size each task needs, its deepest use so far plus
+// MEMORY_STACK_LOW. Control and TCP stay at 4096 until that is read off hardware
+// after a run through connect, config updates and failsafe
+#define MEMORY_STACK_GPS        3072            // Parses in place, about 2 KB used
+#define MEMORY_STACK_CONTROL    4096
+#define MEMORY_STACK_TCP        4096
+#define MEMORY_STACK_OTA        4096            // Image verify in esp_ota_set_boot_partition, memory report
+// All application task stacks together, checked at compile time
+#define MEMORY_STACK_BUDGET     (15 * 1024)
+#define MEMORY_REPORT_MS        10000           // Between reports, printed by the OTA task
+// Less unused stack than this is reported as a warning
+#define MEMORY_STACK_LOW        512
+#define MEMORY_STACK_ROUND      256             // Suggested sizes are rounded up to this
+
+#define MEMORY_MAX_TASKS        8
+#define MEMORY_NAME_LEN         16
+
+
+// Custom data types
+// One application task, its stack and the heap use after boot while it ran
+typedef struct Memory_Task{
+    void *handle;                               // TaskHandle_t
+    char name[MEMORY_NAME_LEN];
+    uint32_t stack_len;
+    uint32_t allocs;                            // Since boot, counted by the heap hook
+    uint32_t alloc_bytes;
+} memory_task_t;
+
+#endif
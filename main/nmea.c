@@ -0,0 +1,205 @@
+/*
+This file holds the NMEA parsers generated from the schemas in nmea.h
+Each sentence gets its own parser. The field numbers are constants, so the
+comma skipping between fields folds into straight-line code and there is no
+per field lookup or dispatch, and no copy of the fields into temporary strings
+Plain C, no ESP-IDF headers, so host side tools can build it too
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdint.h>
+#include <string.h>
+#include "nmea.h"
+
+#define NMEA_ID(a, b, c)    (((uint32_t) (a) << 16) | ((uint32_t) (b) << 8) | (uint32_t) (c))
+#define NMEA_IS_DIGIT(c)    ((uint8_t) ((c) - '0') < 10)
+#define NMEA_MAX_FRAC       7
+
+static const float nmea_frac_scale[NMEA_MAX_FRAC + 1] = {
+    1.0f, 1e-1f, 1e-2f, 1e-3f, 1e-4f, 1e-5f, 1e-6f, 1e-7f
+};
+
+
+// Nmea_Skip_Fields
+// Moves p to the start of the field n fields further on
+// Returns NULL if the sentence ends first
+static inline const char* Nmea_Skip_Fields(const char *p, const char *end, int n){
+    while(n-- > 0){
+        p = memchr(p, ',', end - p);
+        if(p == NULL) return NULL;
+        p++;
+    }
+    return p;
+}
+
+
+// Nmea_Decimal
+// Parses [-]int[.frac] at p, stopping at the first other character
+// Returns the integer part, the fraction goes to frac as a value in [0, 1)
+static inline int32_t Nmea_Decimal(const char *p, const char *end, float *frac, uint8_t *neg){
+    int32_t whole = 0;
+    int32_t part = 0;
+    uint8_t digits = 0;
+
+    *neg = (p < end) && (*p == '-');
+    p += *neg;
+    while((p < end) && NMEA_IS_DIGIT(*p)){
+        whole = whole * 10 + (*p++ - '0');
+    }
+    if((p < end) && (*p == '.')){
+        p++;
+        while((p < end) && NMEA_IS_DIGIT(*p) && (digits < NMEA_MAX_FRAC)){
+            part = part * 10 + (*p++ - '0');
+            digits++;
+        }
+    }
+    *frac = (float) part * nmea_frac_scale[digits];
+    return whole;
+}
+
+
+// Field parsers, one per NMEA_T_ type in nmea.h
+
+static inline void Nmea_Float(const char *p, const char *end, float *out){
+    float frac;
+    uint8_t neg;
+    float value = (float) Nmea_Decimal(p, end, &frac, &neg) + frac;
+    *out = neg ? -value : value;
+}
+
+static inline void Nmea_U8(const char *p, const char *end, uint8_t *out){
+    float frac;
+    uint8_t neg;
+    *out = (uint8_t) Nmea_Decimal(p, end, &frac, &neg);
+}
+
+static inline void Nmea_Char(const char *p, const char *end, char *out){
+    *out = ((p < end) && (*p != ',')) ? *p : '\0';
+}
+
+// ddmm.mmmm or dddmm.mmmm, the split between degrees and minutes is always
+// two digits before the point, so one parser serves both
+static inline void Nmea_Deg_Min(const char *p, const char *end, float *out){
+    float frac;
+    uint8_t neg;
+    int32_t ddmm = Nmea_Decimal(p, end, &frac, &neg);
+    *out = (float) (ddmm / 100) + ((float) (ddmm % 100) + frac) * (1.0f / 60.0f);
+}
+
+static inline void Nmea_Hemi(const char *p, const char *end, float *member){
+    if((p < end) && ((*p == 'S') || (*p == 'W'))) *member = -*member;
+}
+
+static inline void Nmea_Time(const char *p, const char *end, nmea_time_t *out){
+    uint16_t scale = 100;
+    uint8_t i;
+
+    if((end - p < 6) || !NMEA_IS_DIGIT(p[0]) || !NMEA_IS_DIGIT(p[1]) || !NMEA_IS_DIGIT(p[2])
+       || !NMEA_IS_DIGIT(p[3]) || !NMEA_IS_DIGIT(p[4]) || !NMEA_IS_DIGIT(p[5])){
+        return;
+    }
+    out->hour = (p[0] - '0') * 10 + (p[1] - '0');
+    out->minute = (p[2] - '0') * 10 + (p[3] - '0');
+    out->second = (p[4] - '0') * 10 + (p[5] - '0');
+    out->millisecond = 0;
+    if((end - p > 6) && (p[6] == '.')){
+        for(i = 7; (i < 10) && (p + i < end) && NMEA_IS_DIGIT(p[i]); i++){
+            out->millisecond += (p[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+    out->valid = 1;
+}
+
+static inline void Nmea_Date(const char *p, const char *end, nmea_date_t *out){
+    if((end - p < 6) || !NMEA_IS_DIGIT(p[0]) || !NMEA_IS_DIGIT(p[1]) || !NMEA_IS_DIGIT(p[2])
+       || !NMEA_IS_DIGIT(p[3]) || !NMEA_IS_DIGIT(p[4]) || !NMEA_IS_DIGIT(p[5])){
+        return;
+    }
+    out->day = (p[0] - '0') * 10 + (p[1] - '0');
+    out->month = (p[2] - '0') * 10 + (p[3] - '0');
+    out->year = (p[4] - '0') * 10 + (p[5] - '0');
+    out->valid = 1;
+}
+
+#define NMEA_PARSE_TIME(p, end, m)  Nmea_Time(p, end, &(m))
+#define NMEA_PARSE_DATE(p, end, m)  Nmea_Date(p, end, &(m))
+#define NMEA_PARSE_LAT(p, end, m)   Nmea_Deg_Min(p, end, &(m))
+#define NMEA_PARSE_LON(p, end, m)   Nmea_Deg_Min(p, end, &(m))
+#define NMEA_PARSE_HEMI(p, end, m)  Nmea_Hemi(p, end, &(m))
+#define NMEA_PARSE_FLOAT(p, end, m) Nmea_Float(p, end, &(m))
+#define NMEA_PARSE_U8(p, end, m)    Nmea_U8(p, end, &(m))
+#define NMEA_PARSE_CHAR(p, end, m)  Nmea_Char(p, end, &(m))
+
+
+// Generated sentence parsers, e.g. Nmea_Parse_GGA
+// p starts at field 0 (the sentence ID), end is the '*' or the end of the line
+// Return 1 on success, 0 if the sentence has fewer fields than the schema
+#define NMEA_PARSE_FIELD(field, type, member) \
+    p = Nmea_Skip_Fields(p, end, (field) - at); \
+    if(p == NULL) return 0; \
+    at = (field); \
+    NMEA_PARSE_##type(p, end, out->member);
+
+#define NMEA_DEFINE_PARSER(NAME, name, a, b, c) \
+static uint8_t Nmea_Parse_##NAME(const char *p, const char *end, nmea_##name##_t *out){ \
+    int at = 0; \
+    memset(out, 0, sizeof(nmea_##name##_t)); \
+    NMEA_##NAME(NMEA_PARSE_FIELD) \
+    return 1; \
+}
+NMEA_SENTENCES(NMEA_DEFINE_PARSER)
+
+
+// Nmea_Hex
+// Returns the value of one hex digit, 0xFF if it is not one
+static inline uint8_t Nmea_Hex(char c){
+    if(NMEA_IS_DIGIT(c)) return c - '0';
+    if((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    return 0xFF;
+}
+
+
+// Nmea_Parse_Line
+// Parses one sentence, "$ttSSS,...*hh" with or without the trailing "\r\n"
+// The checksum is required, a line cut short loses it. Talker ID is ignored
+// Returns the type stored in out, NMEA_NONE for unknown or corrupt sentences
+nmea_msg_type_t Nmea_Parse_Line(const char *line, uint16_t len, nmea_msg_t *out){
+    const char *end = line + len;
+    const char *p;
+    uint8_t sum = 0;
+
+    out->type = NMEA_NONE;
+    if((len < 7) || (line[0] != '$') || (line[6] != ',')) return NMEA_NONE;
+
+    for(p = line + 1; (p < end) && (*p != '*') && (*p != '\r') && (*p != '\n'); p++){
+        sum ^= (uint8_t) *p;
+    }
+    if((p < end) && (*p == '*')){
+        if((end - p < 3) || (((Nmea_Hex(p[1]) << 4) | Nmea_Hex(p[2])) != sum)) return NMEA_NONE;
+    }
+#ifndef NMEA_CHECKSUM_OPTIONAL
+    else{
+        return NMEA_NONE;
+    }
+#endif
+
+#define NMEA_DISPATCH(NAME, name, a, b, c) \
+    case NMEA_ID(a, b, c): \
+        if(Nmea_Parse_##NAME(line + 1, p, &out->name)) out->type = NMEA_MSG_##NAME; \
+    break;
+
+    switch(NMEA_ID(line[3], line[4], line[5])){
+    NMEA_SENTENCES(NMEA_DISPATCH)
+    default:
+    break;
+    }
+    return out->type;
+}
+
@@ -0,0 +1,137 @@
+/*
+This file holds the NMEA sentence schemas and the types for nmea.c
+Plain C, no ESP-IDF headers, so host side tools can build the parsers too
+Sentences without a "*hh" checksum are rejected. Host tools reading logs
+that lack them can build with -DNMEA_CHECKSUM_OPTIONAL
+
+Every message is described once as an X-macro table. nmea.c expands each
+table into a struct and into a straight-line parser for that message only,
+so adding a message or a field is one line here and no index juggling
+
+NMEA tables list X(field, TYPE, member)
+    field   Field number, the sentence ID is field 0. Must be increasing
+    TYPE    One of the NMEA_T_ parsers below
+    member  Struct member the field is stored in
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef NMEA_H
+#define NMEA_H
+
+#include <stdint.h>
+
+// Field types
+// TIME hhmmss.sss     -> nmea_time_t
+// DATE ddmmyy         -> nmea_date_t
+// LAT  ddmm.mmmm      -> float degrees
+// LON  dddmm.mmmm     -> float degrees
+// HEMI N/S/E/W        -> negates the member named in the table for S and W, no member of its own
+// FLOAT, U8, CHAR     -> float, uint8_t, char
+// Empty fields parse as 0, except TIME and DATE which are marked not valid
+
+// GGA, fix data
+#define NMEA_GGA(X) \
+    X(1, TIME,  time) \
+    X(2, LAT,   lat) \
+    X(3, HEMI,  lat) \
+    X(4, LON,   lon) \
+    X(5, HEMI,  lon) \
+    X(6, U8,    quality) \
+    X(7, U8,    sats) \
+    X(8, FLOAT, hdop) \
+    X(9, FLOAT, altitude)
+
+// RMC, recommended minimum
+#define NMEA_RMC(X) \
+    X(1, TIME,  time) \
+    X(2, CHAR,  status) \
+    X(3, LAT,   lat) \
+    X(4, HEMI,  lat) \
+    X(5, LON,   lon) \
+    X(6, HEMI,  lon) \
+    X(7, FLOAT, speed_knots) \
+    X(8, FLOAT, course_deg) \
+    X(9, DATE,  date)
+
+// VTG, course and speed over ground
+#define NMEA_VTG(X) \
+    X(1, FLOAT, course_deg) \
+    X(5, FLOAT, speed_knots) \
+    X(7, FLOAT, speed_kmh)
+
+// GSA, DOP and fix mode
+#define NMEA_GSA(X) \
+    X(1, CHAR,  mode) \
+    X(2, U8,    fix_type) \
+    X(15, FLOAT, pdop) \
+    X(16, FLOAT, hdop) \
+    X(17, FLOAT, vdop)
+
+// All NMEA sentences the parser knows. X(NAME, name, id0, id1, id2)
+// The talker (GP, GN, GL...) is ignored
+#define NMEA_SENTENCES(X) \
+    X(GGA, gga, 'G', 'G', 'A') \
+    X(RMC, rmc, 'R', 'M', 'C') \
+    X(VTG, vtg, 'V', 'T', 'G') \
+    X(GSA, gsa, 'G', 'S', 'A')
+
+
+// Custom data types
+typedef struct NMEA_Time{
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t valid;
+    uint16_t millisecond;
+} nmea_time_t;
+
+typedef struct NMEA_Date{
+    uint8_t day;
+    uint8_t month;
+    uint8_t year;                               // Two digits
+    uint8_t valid;
+} nmea_date_t;
+
+// C type of each field type. HEMI modifies another member and has none
+#define NMEA_DECL_TIME(m)   nmea_time_t m;
+#define NMEA_DECL_DATE(m)   nmea_date_t m;
+#define NMEA_DECL_LAT(m)    float m;
+#define NMEA_DECL_LON(m)    float m;
+#define NMEA_DECL_HEMI(m)
+#define NMEA_DECL_FLOAT(m)  float m;
+#define NMEA_DECL_U8(m)     uint8_t m;
+#define NMEA_DECL_CHAR(m)   char m;
+
+// One struct per sentence, e.g. nmea_gga_t
+#define NMEA_DECL_FIELD(field, type, member) NMEA_DECL_##type(member)
+#define NMEA_DECL_SENTENCE(NAME, name, a, b, c) \
+    typedef struct NMEA_##NAME{ NMEA_##NAME(NMEA_DECL_FIELD) } nmea_##name##_t;
+NMEA_SENTENCES(NMEA_DECL_SENTENCE)
+
+// Message type codes, NMEA_NONE for anything unknown or corrupt
+#define NMEA_ENUM(NAME, name, a, b, c) NMEA_MSG_##NAME,
+typedef enum NMEA_Msg_Type{
+    NMEA_NONE = 0,
+    NMEA_SENTENCES(NMEA_ENUM)
+    NMEA_NUM_TYPES
+} nmea_msg_type_t;
+
+// One parsed sentence of any type
+#define NMEA_UNION_MEMBER(NAME, name, a, b, c) nmea_##name##_t name;
+typedef struct NMEA_Msg{
+    nmea_msg_type_t type;
+    union{
+        NMEA_SENTENCES(NMEA_UNION_MEMBER)
+    };
+} nmea_msg_t;
+
+
+// Function prototypes, shared with the host tools so not in functions.h
+nmea_msg_type_t Nmea_Parse_Line(const char *line, uint16_t len, nmea_msg_t *out);
+
+#endif
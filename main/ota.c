@@ -0,0 +1,471 @@
+/*
+This file holds the source code for over-the-air firmware updates
+The update server runs next to the ground station. Every OTA_POLL_MS the
+vehicle sends the hash of its running image and the server answers with
+the image it has. A new image is written block by block into the other app
+partition, and the next boot runs it on trial: the control loop has to
+prove it still keeps its period before the image is marked valid,
+otherwise the bootloader goes back to the old one
+
+Blocks are written with esp_partition directly rather than esp_ota_write,
+which always starts from an erased partition. That way a download that
+drops out continues at the last saved block instead of starting over
+Flash erases stall the caches of both cores, so the control loop can run
+late while a download is in progress
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "nvs.h"
+#include "rom/miniz.h"
+#include "sdkconfig.h"
+#include "ota.h"
+#include "memory.h"
+#include "config.h"
+#include "tcp_client.h"
+#include "telemetry.h"
+#include "functions.h"
+
+
+// Global to this file
+// Everything but the verify state is only used by Ota_Task
+static tcp_conn_t ota_conn;
+static uint8_t ota_rx[2 * (sizeof(tlm_header_t) + TLM_MAX_PAYLOAD)];
+static uint16_t ota_rx_len = 0;
+static uint16_t ota_rx_used = 0;                // Bytes of the frame Ota_Recv_Frame returned last
+static uint8_t ota_enc[TLM_OTA_BLOCK_LEN];      // Encoded block being assembled
+static uint8_t ota_block[TLM_OTA_BLOCK_LEN];
+static tinfl_decompressor ota_inflate;          // About 11 KB, too big for the task stack
+static uint8_t ota_running_hash[TLM_OTA_HASH_LEN];
+static uint8_t ota_rejected_hash[TLM_OTA_HASH_LEN];   // Image that was rolled back, never installed again
+static uint8_t ota_rejected_valid = 0;
+static const esp_partition_t *ota_running = NULL;
+static int8_t ota_health_id = -1;
+static TaskHandle_t ota_task = NULL;
+static esp_timer_handle_t ota_verify_timer = NULL;
+static _Atomic uint8_t ota_verify = OTA_VERIFY_NONE;
+static uint16_t ota_verify_count = 0;           // Control loop only
+static uint16_t ota_verify_late = 0;            // Control loop only
+static uint8_t ota_verify_failsafe = 0;         // Control loop only, failsafe raised when warm up ended
+static _Atomic uint32_t ota_verify_stalls = UINT32_MAX;  // Stalls when warm up ended
+static uint32_t ota_verify_timeout_ms = 0;
+static const char* OTA_TAG = "OTA";
+
+
+// Ota_Verify_Timeout
+// The new image never got through its check. Also covers a control loop that
+// never runs, so it does not wait for the OTA task
+static void Ota_Verify_Timeout(void *args){
+    ESP_LOGE(OTA_TAG, "New image not verified within %lu ms, rolling back", (unsigned long) ota_verify_timeout_ms);
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+
+// Init_Ota
+// Reports a rollback from the last run and, on the first boot of a new image,
+// starts its trial. Must be called after Config_Init, before the control loop starts
+void Init_Ota(void){
+    const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+    esp_ota_img_states_t state;
+
+    Tcp_Conn_Init(&ota_conn);
+    ota_conn.unit_id = Get_Unit_ID();           // Init_Tcp_Client ran first
+    ota_running = esp_ota_get_running_partition();
+    if(invalid != NULL){
+        ESP_LOGW(OTA_TAG, "Image in %s was rolled back, running %s", invalid->label, ota_running->label);
+    }
+
+    if((esp_ota_get_state_partition(ota_running, &state) != ESP_OK) || (state != ESP_OTA_IMG_PENDING_VERIFY)) return;
+
+    esp_timer_create_args_t verify_timer_args = {
+        .callback = Ota_Verify_Timeout,
+        .name = "ota_verify",
+    };
+    // A slow configured period must still get its iterations in
+    ota_verify_timeout_ms = (uint32_t) (((uint64_t) (OTA_VERIFY_WARMUP + OTA_VERIFY_ITERATIONS) * Config_Get()->control_period_us + 999) / 1000)
+                            + OTA_VERIFY_MARGIN_MS;
+    ESP_ERROR_CHECK(esp_timer_create(&verify_timer_args, &ota_verify_timer));
+    ESP_ERROR_CHECK(esp_timer_start_once(ota_verify_timer, (uint64_t) ota_verify_timeout_ms * 1000));
+    atomic_store(&ota_verify, OTA_VERIFY_PENDING);
+    ESP_LOGW(OTA_TAG, "First boot of the image in %s, on trial for up to %lu ms", ota_running->label,
+             (unsigned long) ota_verify_timeout_ms);
+}
+
+
+// Ota_Control_Check
+// Called by the control loop once per iteration with whether it woke within
+// its jitter budget and the failsafe it raised. Only counts, the flash writes
+// are left to the OTA task. Never blocks
+void Ota_Control_Check(uint8_t on_time, uint8_t failsafe){
+    if(atomic_load_explicit(&ota_verify, memory_order_relaxed) != OTA_VERIFY_PENDING) return;
+
+    if(++ota_verify_count <= OTA_VERIFY_WARMUP){
+        // No fix or no link yet is normal this soon after boot
+        ota_verify_failsafe = failsafe;
+        if(ota_verify_count == OTA_VERIFY_WARMUP) atomic_store(&ota_verify_stalls, Health_Stalls());
+        return;
+    }
+    if(!on_time) ota_verify_late++;
+
+    if(failsafe & ~ota_verify_failsafe){
+        atomic_store(&ota_verify, OTA_VERIFY_FAILSAFE);
+    }
+    else if(ota_verify_late > OTA_VERIFY_MAX_LATE){
+        atomic_store(&ota_verify, OTA_VERIFY_FAILED);
+    }
+    else if(ota_verify_count >= OTA_VERIFY_WARMUP + OTA_VERIFY_ITERATIONS){
+        atomic_store(&ota_verify, OTA_VERIFY_PASSED);
+    }
+    else{
+        return;
+    }
+    if(ota_task != NULL) xTaskNotifyGive(ota_task);
+}
+
+
+// Ota_Finish_Verify
+// Acts on the control loop's verdict on a new image, and on task stalls
+// A watchdog reset while on trial rolls back in the bootloader
+static void Ota_Finish_Verify(void){
+    uint8_t verdict = atomic_load(&ota_verify);
+    uint32_t stalls = atomic_load(&ota_verify_stalls);
+
+    if(verdict == OTA_VERIFY_FAILED){
+        ESP_LOGE(OTA_TAG, "Control loop woke late over %d times on the new image, rolling back", OTA_VERIFY_MAX_LATE);
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+    else if(verdict == OTA_VERIFY_FAILSAFE){
+        ESP_LOGE(OTA_TAG, "Failsafe raised on the new image, rolling back");
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+    else if((verdict == OTA_VERIFY_PENDING) && (stalls != UINT32_MAX) && (Health_Stalls() > stalls)){
+        ESP_LOGE(OTA_TAG, "Task stalled on the new image, rolling back");
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+    else if(verdict == OTA_VERIFY_PASSED){
+        esp_timer_stop(ota_verify_timer);
+        ESP_ERROR_CHECK(esp_ota_mark_app_valid_cancel_rollback());
+        atomic_store(&ota_verify, OTA_VERIFY_NONE);
+        ESP_LOGI(OTA_TAG, "New image passed %d control loop iterations, %u late, kept", OTA_VERIFY_ITERATIONS,
+                 (unsigned) ota_verify_late);
+    }
+}
+
+
+// Ota_Save_Progress
+// Stores the resume point, NULL clears it
+static void Ota_Save_Progress(const ota_progress_t *progress){
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    err = nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if(err == ESP_OK){
+        if(progress != NULL) err = nvs_set_blob(nvs, OTA_NVS_KEY, progress, sizeof(ota_progress_t));
+        else err = nvs_erase_key(nvs, OTA_NVS_KEY);
+        if(err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+        if(err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if(err != ESP_OK) ESP_LOGW(OTA_TAG, "Progress not saved (%s)", esp_err_to_name(err));
+}
+
+
+// Ota_Load_Progress
+// Returns the block to continue the image at, 0 if there is nothing to resume
+static uint32_t Ota_Load_Progress(const tlm_ota_info_t *info, const esp_partition_t *target){
+    ota_progress_t progress;
+    size_t blob_len = sizeof(ota_progress_t);
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    err = nvs_open(CFG_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if(err != ESP_OK) return 0;
+    err = nvs_get_blob(nvs, OTA_NVS_KEY, &progress, &blob_len);
+    nvs_close(nvs);
+
+    if((err != ESP_OK) || (blob_len != sizeof(ota_progress_t))) return 0;
+    if(memcmp(progress.image_hash, info->image_hash, TLM_OTA_HASH_LEN) != 0) return 0;
+    if((progress.image_len != info->image_len) || (progress.partition_addr != target->address)) return 0;
+    return progress.next_block;
+}
+
+
+// Ota_Load_Rejected
+// Finds the hash of the image that was last rolled back. Hashed from its
+// partition while that still holds it, and kept in NVS for when a later
+// download starts overwriting it
+static void Ota_Load_Rejected(void){
+    const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+    size_t blob_len = TLM_OTA_HASH_LEN;
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    if((invalid != NULL) && (esp_partition_get_sha256(invalid, ota_rejected_hash) == ESP_OK)){
+        ota_rejected_valid = 1;
+        err = nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+        if(err == ESP_OK){
+            err = nvs_set_blob(nvs, OTA_NVS_REJECTED_KEY, ota_rejected_hash, TLM_OTA_HASH_LEN);
+            if(err == ESP_OK) err = nvs_commit(nvs);
+            nvs_close(nvs);
+        }
+        if(err != ESP_OK) ESP_LOGW(OTA_TAG, "Rejected image not saved (%s)", esp_err_to_name(err));
+        return;
+    }
+
+    if(nvs_open(CFG_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return;
+    err = nvs_get_blob(nvs, OTA_NVS_REJECTED_KEY, ota_rejected_hash, &blob_len);
+    nvs_close(nvs);
+    ota_rejected_valid = (err == ESP_OK) && (blob_len == TLM_OTA_HASH_LEN);
+}
+
+
+// Ota_Recv_Frame
+// Waits for the next whole frame from the server, flushing queued requests meanwhile
+// The frame stays valid until the next call
+// Returns the payload length, TCP_ERR on a bad frame, timeout or disconnect
+static int Ota_Recv_Frame(const tlm_header_t **header){
+    int64_t deadline_us = esp_timer_get_time() + (int64_t) OTA_RX_TIMEOUT_MS * 1000;
+    const tlm_header_t *h;
+    int len;
+
+    memmove(ota_rx, &ota_rx[ota_rx_used], ota_rx_len - ota_rx_used);
+    ota_rx_len -= ota_rx_used;
+    ota_rx_used = 0;
+
+    while(1){
+        if(ota_rx_len >= sizeof(tlm_header_t)){
+            h = (const tlm_header_t *) ota_rx;
+            if((h->magic != TLM_MAGIC) || (h->version != TLM_VERSION) || (h->length > TLM_MAX_PAYLOAD)){
+                ESP_LOGE(OTA_TAG, "Bad frame from update server");
+                return TCP_ERR;
+            }
+            if(ota_rx_len >= sizeof(tlm_header_t) + h->length){
+                ota_rx_used = sizeof(tlm_header_t) + h->length;
+                *header = h;
+                return h->length;
+            }
+        }
+
+        Health_Beat(ota_health_id);
+        if(esp_timer_get_time() > deadline_us){
+            ESP_LOGW(OTA_TAG, "Update server stopped answering");
+            return TCP_ERR;
+        }
+        if(Tcp_Conn_Flush(&ota_conn, 0) < 0) return TCP_ERR;
+        len = Tcp_Conn_Recv(&ota_conn, &ota_rx[ota_rx_len], sizeof(ota_rx) - ota_rx_len, OTA_RX_WAIT_MS);
+        if(len < 0) return TCP_ERR;
+        ota_rx_len += len;
+    }
+}
+
+
+// Ota_Decode_Block
+// Turns an encoded block into the image bytes, in ota_block or in place in ota_enc
+// Returns the decoded bytes, NULL if the block is corrupt
+static const uint8_t* Ota_Decode_Block(const tlm_ota_data_t *data, uint32_t block_len){
+    size_t in_len = data->enc_len;
+    size_t out_len = block_len;
+    tinfl_status status;
+
+    switch(data->encoding){
+    case TLM_OTA_ENC_RAW:
+        if(data->enc_len != block_len) return NULL;
+        return ota_enc;
+
+    case TLM_OTA_ENC_DEFLATE:
+        tinfl_init(&ota_inflate);
+        status = tinfl_decompress(&ota_inflate, ota_enc, &in_len, ota_block, ota_block, &out_len,
+                                  TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+        if((status != TINFL_STATUS_DONE) || (out_len != block_len)) return NULL;
+        return ota_block;
+
+    case TLM_OTA_ENC_COPY:
+        if(data->src + block_len > ota_running->size) return NULL;
+        if(esp_partition_read(ota_running, data->src, ota_block, block_len) != ESP_OK) return NULL;
+        return ota_block;
+
+    default:
+        return NULL;
+    }
+}
+
+
+// Ota_Request
+// Queues a request for count blocks starting at first
+static int Ota_Request(uint32_t first, uint16_t count){
+    tlm_ota_req_t req = {
+        .first_block = first,
+        .count = count,
+    };
+    return Tcp_Conn_Send_Frame(&ota_conn, TLM_TYPE_OTA_REQ, &req, sizeof(req));
+}
+
+
+// Ota_Session
+// One exchange with the update server on an open connection
+// Only returns if there is nothing to install or the download failed
+static void Ota_Session(void){
+    const esp_partition_t *target = esp_ota_get_next_update_partition(NULL);
+    const tlm_header_t *header;
+    const uint8_t *bytes;
+    tlm_ota_query_t query;
+    tlm_ota_info_t info;
+    tlm_ota_data_t data;
+    ota_progress_t progress;
+    uint32_t num_blocks;
+    uint32_t block;
+    uint32_t requested;
+    uint32_t count;
+    uint32_t block_len;
+    uint16_t received = 0;
+    uint16_t piece_len;
+    esp_err_t err;
+    int len;
+
+    ota_rx_len = 0;
+    ota_rx_used = 0;
+    memcpy(query.running_hash, ota_running_hash, TLM_OTA_HASH_LEN);
+    query.encodings = OTA_ENCODINGS;
+    if(Tcp_Conn_Send_Frame(&ota_conn, TLM_TYPE_OTA_QUERY, &query, sizeof(query)) < 0) return;
+
+    len = Ota_Recv_Frame(&header);
+    if((len != sizeof(tlm_ota_info_t)) || (header->type != TLM_TYPE_OTA_INFO)) return;
+    memcpy(&info, &header[1], sizeof(info));
+    if(info.image_len == 0) return;
+    // Installing it again would only roll back again, on every poll
+    if(ota_rejected_valid && (memcmp(info.image_hash, ota_rejected_hash, TLM_OTA_HASH_LEN) == 0)){
+        ESP_LOGW(OTA_TAG, "Server offers the image that was rolled back, ignored");
+        return;
+    }
+    if((target == NULL) || (info.image_len > target->size)){
+        ESP_LOGE(OTA_TAG, "Image of %lu bytes does not fit the update partition", (unsigned long) info.image_len);
+        return;
+    }
+
+    num_blocks = (info.image_len + TLM_OTA_BLOCK_LEN - 1) / TLM_OTA_BLOCK_LEN;
+    block = Ota_Load_Progress(&info, target);
+    if(block > num_blocks) block = 0;
+    memcpy(progress.image_hash, info.image_hash, TLM_OTA_HASH_LEN);
+    progress.image_len = info.image_len;
+    progress.partition_addr = target->address;
+    ESP_LOGI(OTA_TAG, "Downloading %02x%02x%02x%02x, %lu bytes to %s, from block %lu of %lu",
+             info.image_hash[0], info.image_hash[1], info.image_hash[2], info.image_hash[3],
+             (unsigned long) info.image_len, target->label, (unsigned long) block, (unsigned long) num_blocks);
+
+    // Sliding window, every written block makes room for the next request
+    requested = block;
+    while(block < num_blocks){
+        count = OTA_WINDOW_BLOCKS - (requested - block);
+        if(requested + count > num_blocks) count = num_blocks - requested;
+        if(count > 0){
+            if(Ota_Request(requested, count) < 0) return;
+            requested += count;
+        }
+
+        len = Ota_Recv_Frame(&header);
+        if((len < (int) sizeof(tlm_ota_data_t)) || (header->type != TLM_TYPE_OTA_DATA)) return;
+        memcpy(&data, &header[1], sizeof(data));
+        piece_len = len - sizeof(tlm_ota_data_t);
+
+        // Pieces of a block arrive in order, anything else means the stream is broken
+        if((data.block != block) || (data.offset != received) || (data.enc_len > TLM_OTA_BLOCK_LEN)
+           || (data.offset + piece_len > data.enc_len)){
+            ESP_LOGE(OTA_TAG, "Unexpected piece of block %lu", (unsigned long) data.block);
+            return;
+        }
+        memcpy(&ota_enc[received], (const uint8_t *) &header[1] + sizeof(tlm_ota_data_t), piece_len);
+        received += piece_len;
+        if(received < data.enc_len) continue;
+
+        block_len = info.image_len - block * TLM_OTA_BLOCK_LEN;
+        if(block_len > TLM_OTA_BLOCK_LEN) block_len = TLM_OTA_BLOCK_LEN;
+        bytes = Ota_Decode_Block(&data, block_len);
+        if(bytes == NULL){
+            ESP_LOGE(OTA_TAG, "Block %lu is corrupt", (unsigned long) block);
+            return;
+        }
+        err = esp_partition_erase_range(target, block * TLM_OTA_BLOCK_LEN, TLM_OTA_BLOCK_LEN);
+        if(err == ESP_OK) err = esp_partition_write(target, block * TLM_OTA_BLOCK_LEN, bytes, block_len);
+        if(err != ESP_OK){
+            ESP_LOGE(OTA_TAG, "Writing block %lu failed (%s)", (unsigned long) block, esp_err_to_name(err));
+            return;
+        }
+        block++;
+        received = 0;
+        if((block % OTA_PROGRESS_BLOCKS) == 0){
+            progress.next_block = block;
+            Ota_Save_Progress(&progress);
+        }
+    }
+
+    // Verifies the whole image, the hash esptool appended and its signature
+    Ota_Save_Progress(NULL);
+    err = esp_ota_set_boot_partition(target);
+    if(err != ESP_OK){
+        ESP_LOGE(OTA_TAG, "Downloaded image rejected (%s)", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGW(OTA_TAG, "Image written to %s, restarting", target->label);
+    Tcp_Conn_Close(&ota_conn);
+    esp_restart();
+}
+
+
+// Ota_Task
+// Finishes the trial of a new image, then polls the update server
+void Ota_Task(void *args){
+    const laelaps_config_t *cfg;
+    uint32_t idle_ms = OTA_POLL_MS;             // First poll right away
+    int64_t report_us = esp_timer_get_time();
+    esp_err_t err;
+
+    ota_task = xTaskGetCurrentTaskHandle();
+    ota_health_id = Health_Register(TCP_HEALTH_PERIOD_MS);
+
+    // Hashes whole images, so here and not in Init_Ota where it would delay boot
+    err = esp_partition_get_sha256(ota_running, ota_running_hash);
+    if(err != ESP_OK){
+        ESP_LOGE(OTA_TAG, "Cannot hash the running image (%s), updates off", esp_err_to_name(err));
+    }
+    Ota_Load_Rejected();
+    Memory_Task_Ready();
+
+    while(1){
+        Health_Beat(ota_health_id);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OTA_IDLE_MS));
+        Ota_Finish_Verify();
+        idle_ms += OTA_IDLE_MS;
+        // Low priority and not timed, so logging and the heap walk cost the control loop nothing
+        if(esp_timer_get_time() - report_us >= (int64_t) MEMORY_REPORT_MS * 1000){
+            report_us = esp_timer_get_time();
+            Control_Report_Timing();
+            Power_Report();
+            Memory_Report();
+        }
+
+        // No update while a new image is still on trial, it could not be rolled back
+        cfg = Config_Get();
+        if((err != ESP_OK) || (cfg->ota_port == 0) || (idle_ms < OTA_POLL_MS)) continue;
+        if(atomic_load(&ota_verify) != OTA_VERIFY_NONE) continue;
+        idle_ms = 0;
+
+        if(Tcp_Conn_Open(&ota_conn, OTA_TAG, cfg->tlm_host, cfg->ota_port, ota_health_id) < 0) continue;
+        Ota_Session();
+        Tcp_Conn_Close(&ota_conn);
+    }
+}
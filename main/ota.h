@@ -0,0 +1,69 @@
+/*
+This file holds the macro definitions and types for ota.c
+Needs the dual app partition table in partitions.csv and
+CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE in sdkconfig, see sdkconfig.defaults.
+Without rollback a bad image is never marked invalid and stays booted
+Downloads are not trusted. Only images signed with the project key pass
+esp_ota_set_boot_partition (CONFIG_SECURE_SIGNED_ON_UPDATE_NO_SECURE_BOOT),
+anything else only ever lands in the partition not running
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef OTA_H
+#define OTA_H
+
+#include <stdint.h>
+#include "telemetry.h"
+
+// Defaults, used when no configuration is stored in NVS
+// The update server runs on the telemetry host
+#define OTA_PORT                5761            // 0 disables updates
+
+// Update session
+#define OTA_POLL_MS             30000           // Time between asking the server for a new image
+#define OTA_IDLE_MS             1000            // Task wake up while idle, keeps the watchdog fed
+#define OTA_RX_TIMEOUT_MS       5000            // Longest wait for a reply before giving up the session
+#define OTA_RX_WAIT_MS          500             // One receive, the task beats in between
+#define OTA_WINDOW_BLOCKS       8               // Blocks requested but not yet written
+#define OTA_PROGRESS_BLOCKS     16              // Blocks between progress saves to NVS
+#define OTA_ENCODINGS           ((1 << TLM_OTA_ENC_RAW) | (1 << TLM_OTA_ENC_DEFLATE) | (1 << TLM_OTA_ENC_COPY))
+
+// Resume point and the hash of the last rolled back image, stored in the config namespace
+#define OTA_NVS_KEY             "ota"
+#define OTA_NVS_REJECTED_KEY    "ota_rejected"
+
+// First boot of a new image
+// The first control loop iterations are not judged, Wi-Fi, the telemetry
+// client and the OTA task are still starting. Of the iterations after them, a
+// few may wake later than control_jitter_budget_us, the loop runs below Wi-Fi
+// and lwIP. It is rolled back on more late wake ups, on a failsafe that was
+// clear when warm up ended, on a task stall, or without a verdict within the
+// iterations at the boot period plus the margin
+#define OTA_VERIFY_WARMUP       20
+#define OTA_VERIFY_ITERATIONS   50
+#define OTA_VERIFY_MAX_LATE     5
+#define OTA_VERIFY_MARGIN_MS    10000           // Boot to the first control loop iteration
+
+#define OTA_VERIFY_NONE         0
+#define OTA_VERIFY_PENDING      1
+#define OTA_VERIFY_PASSED       2
+#define OTA_VERIFY_FAILED       3               // Too many late wake ups
+#define OTA_VERIFY_FAILSAFE     4
+
+
+// Custom data types
+// Where an interrupted download continues. Only valid for the same image
+// going to the same partition
+typedef struct Ota_Progress{
+    uint8_t image_hash[TLM_OTA_HASH_LEN];
+    uint32_t image_len;
+    uint32_t partition_addr;
+    uint32_t next_block;                        // Blocks before this one are written
+} ota_progress_t;
+
+#endif
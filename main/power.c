@@ -0,0 +1,189 @@
+/*
+This file holds the source code for power management
+Built on ESP-IDF PM locks. With power management on the CPU idles at the
+minimum frequency and only runs at the maximum while the control loop or
+the GPS task hold their lock. With light sleep on the chip also sleeps
+whenever no lock is held and no task is ready
+The GPS UART cannot receive in light sleep. The chip is kept awake through
+each NMEA burst and, once the time service knows where the UTC seconds
+fall, allowed to sleep until just before the next burst
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "power.h"
+#include "config.h"
+#include "functions.h"
+
+
+// Global to this file
+static const esp_pm_lock_type_t power_lock_types[POWER_NUM_LOCKS] = {
+    [POWER_LOCK_CONTROL] = ESP_PM_CPU_FREQ_MAX,
+    [POWER_LOCK_GPS]     = ESP_PM_CPU_FREQ_MAX,
+    [POWER_LOCK_GPS_RX]  = ESP_PM_NO_LIGHT_SLEEP,
+};
+static const char* power_lock_names[POWER_NUM_LOCKS] = {
+    [POWER_LOCK_CONTROL] = "control",
+    [POWER_LOCK_GPS]     = "gps",
+    [POWER_LOCK_GPS_RX]  = "gps_rx",
+};
+static esp_pm_lock_handle_t power_locks[POWER_NUM_LOCKS];
+static uint8_t power_enabled = 0;
+static uint8_t power_light_sleep = 0;
+static esp_timer_handle_t power_gps_timer = NULL;
+
+// GPS RX lock state. Shared by the GPS task and the wake timer, USE SPINLOCK
+static portMUX_TYPE power_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t power_gps_rx_held = 0;
+static const char* POWER_TAG = "Power";
+
+
+// Power_GPS_Wake
+// esp_timer callback. Keeps the chip awake for the next NMEA burst
+static void Power_GPS_Wake(void *args){
+    Power_GPS_Hold_Awake();
+}
+
+
+// Init_Power
+// Configures DFS and light sleep and creates the locks
+// Without CONFIG_PM_ENABLE in sdkconfig this logs a warning and every other
+// function in this file does nothing
+void Init_Power(void){
+    const laelaps_config_t *cfg = Config_Get();
+    esp_err_t err;
+    uint8_t i;
+
+    if(!cfg->pm_enable){
+        ESP_LOGI(POWER_TAG, "Power management off");
+        return;
+    }
+
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = cfg->pm_max_mhz,
+        .min_freq_mhz = cfg->pm_min_mhz,
+        .light_sleep_enable = cfg->pm_light_sleep,
+    };
+    err = esp_pm_configure(&pm_config);
+    if(err != ESP_OK){
+        ESP_LOGW(POWER_TAG, "esp_pm_configure failed (%s), running at fixed frequency", esp_err_to_name(err));
+        return;
+    }
+
+    for(i = 0; i < POWER_NUM_LOCKS; i++){
+        ESP_ERROR_CHECK(esp_pm_lock_create(power_lock_types[i], 0, power_lock_names[i], &power_locks[i]));
+    }
+
+    esp_timer_create_args_t gps_timer_args = {
+        .callback = Power_GPS_Wake,
+        .name = "gps_wake",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&gps_timer_args, &power_gps_timer));
+
+    power_light_sleep = cfg->pm_light_sleep;
+    power_enabled = 1;
+
+    // Stay awake for GPS until the burst timing is known
+    Power_GPS_Hold_Awake();
+
+    ESP_LOGI(POWER_TAG, "DFS %d-%d MHz, light sleep %s", cfg->pm_min_mhz, cfg->pm_max_mhz, power_light_sleep ? "on" : "off");
+}
+
+
+// Power_Enabled
+// Returns TRUE if power management is running
+uint8_t Power_Enabled(void){
+    return power_enabled;
+}
+
+
+// Power_Acquire
+// Takes one of the POWER_LOCK_ locks. Locks count, every acquire needs a release
+void Power_Acquire(uint8_t lock){
+    if(!power_enabled || (lock >= POWER_NUM_LOCKS)) return;
+    esp_pm_lock_acquire(power_locks[lock]);
+}
+
+
+// Power_Release
+// Gives back one of the POWER_LOCK_ locks
+void Power_Release(uint8_t lock){
+    if(!power_enabled || (lock >= POWER_NUM_LOCKS)) return;
+    esp_pm_lock_release(power_locks[lock]);
+}
+
+
+// Power_GPS_Hold_Awake
+// Keeps the chip out of light sleep so the GPS UART can receive
+// Safe to call repeatedly, the lock is only taken once
+void Power_GPS_Hold_Awake(void){
+    uint8_t take;
+
+    if(!power_enabled) return;
+    portENTER_CRITICAL(&power_spinlock);
+    take = !power_gps_rx_held;
+    power_gps_rx_held = 1;
+    portEXIT_CRITICAL(&power_spinlock);
+
+    if(take) esp_pm_lock_acquire(power_locks[POWER_LOCK_GPS_RX]);
+}
+
+
+// Power_GPS_Burst_Done
+// Called by the GPS task once the NMEA burst of this second is over
+// Lets the chip sleep and arms a timer to wake it POWER_GPS_GUARD_US before
+// the next UTC second. Does nothing without light sleep or without UTC time
+// Returns TRUE if the chip may now sleep
+uint8_t Power_GPS_Burst_Done(void){
+    int64_t utc_us;
+    int64_t wait_us;
+    uint8_t give;
+
+    if(!power_enabled || !power_light_sleep) return 0;
+    utc_us = Time_Now_UTC();
+    if(utc_us < 0) return 0;
+    wait_us = 1000000 - (utc_us % 1000000) - POWER_GPS_GUARD_US;
+    if(wait_us <= 0) return 0;
+
+    // Stop a pending wake first, it would take the lock right back
+    esp_timer_stop(power_gps_timer);
+    portENTER_CRITICAL(&power_spinlock);
+    give = power_gps_rx_held;
+    power_gps_rx_held = 0;
+    portEXIT_CRITICAL(&power_spinlock);
+    if(give) esp_pm_lock_release(power_locks[POWER_LOCK_GPS_RX]);
+
+    ESP_ERROR_CHECK(esp_timer_start_once(power_gps_timer, wait_us));
+    return 1;
+}
+
+
+// Power_Listen_Interval
+// Returns the Wi-Fi listen interval in beacons matching the telemetry batch interval
+// The station then wakes for beacons about as often as it sends. 0 keeps the IDF default
+uint16_t Power_Listen_Interval(const laelaps_config_t *cfg){
+    if(cfg->tlm_batch_ms == 0) return 0;
+    return (uint16_t) (((uint32_t) cfg->tlm_batch_ms * 1000 + POWER_BEACON_US - 1) / POWER_BEACON_US);
+}
+
+
+// Power_Report
+// Prints time spent in each power mode and per lock
+// Needs CONFIG_PM_PROFILING, does nothing otherwise
+void Power_Report(void){
+#ifdef CONFIG_PM_PROFILING
+    if(power_enabled) esp_pm_dump_locks(stdout);
+#endif
+}
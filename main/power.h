@@ -0,0 +1,42 @@
+/*
+This file holds the macro definitions for power.c
+Needs CONFIG_PM_ENABLE, and CONFIG_FREERTOS_USE_TICKLESS_IDLE for light sleep,
+in sdkconfig. Without them pm_enable only logs a warning
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef POWER_H
+#define POWER_H
+
+// Defaults, used when no configuration is stored in NVS
+// Power management is off by default, the CPU then runs at the sdkconfig frequency
+#define POWER_PM_ENABLE         0
+#define POWER_LIGHT_SLEEP       0
+#define POWER_MAX_MHZ           240
+#define POWER_MIN_MHZ           80
+#define POWER_WIFI_PS           1               // wifi_ps_type_t, 1 is WIFI_PS_MIN_MODEM
+#define POWER_TLM_BATCH_MS      0               // 0 flushes telemetry as soon as it is queued
+#define POWER_TLM_BATCH_MAX_MS  1000
+#define POWER_JITTER_BUDGET_US  1000            // Control loop wake up jitter allowed
+
+// Locks. Each one is held only while its task is doing work
+#define POWER_LOCK_CONTROL      0               // CPU at max frequency
+#define POWER_LOCK_GPS          1               // CPU at max frequency
+#define POWER_LOCK_GPS_RX       2               // No light sleep, UART RX would lose bytes
+#define POWER_NUM_LOCKS         3
+
+// GPS burst handling in light sleep
+// Once no sentence arrived for this long the once a second NMEA burst is over
+#define POWER_GPS_IDLE_MS       100
+// Wake up this long before the next UTC second, when the next burst starts
+#define POWER_GPS_GUARD_US      20000
+
+// Wi-Fi beacon interval of the AP, in us. Used to convert the batch interval to a listen interval
+#define POWER_BEACON_US         102400
+
+#endif
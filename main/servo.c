@@ -1,10 +1,16 @@
 /*
 This file holds the source code for working with the servo motors
+Channels are described by the servo table in the configuration
+The first SERVO_MCPWM_CHANNELS enabled PWM / OneShot channels are spread over
+both MCPWM groups, any further channels are generated by LEDC
+DShot channels are generated by RMT. An esp_timer resends the latest frame
+of every DShot channel at SERVO_DSHOT_REFRESH_HZ, independent of the control
+loop rate, Set_Servo only changes the frame
 
 Author:         James Sorber
 Contact:        jrsorber@ncsu.edu
 Created:        8/28/2024
-Modified:       -
+Modified:       10/19/2026
 Last Built With ESP-IDF v5.2.2
 */
 
@@ -14,29 +20,93 @@ Last Built With ESP-IDF v5.2.2
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "driver/mcpwm_prelude.h"
+#include "driver/ledc.h"
+#include "driver/rmt_tx.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "sdkconfig.h"
 #include "servo.h"
+#include "config.h"
+#include "gps.h"
 #include "functions.h"
 #include "init.h"
 
 
+// Custom data types
+// Which peripheral drives a channel
+typedef enum Servo_Backend{
+    SERVO_BACKEND_NONE = 0,
+    SERVO_BACKEND_MCPWM,
+    SERVO_BACKEND_LEDC,
+    SERVO_BACKEND_RMT,
+} servo_backend_t;
+
+// Timer settings of each output protocol
+typedef struct Servo_Protocol{
+    uint32_t resolution_hz;
+    uint32_t period_ticks;
+} servo_protocol_t;
+
+// Handle for one output channel. Indexed directly by servo number
+// DShot frames are read by RMT after rmt_transmit returns, so each channel
+// cycles through one more frame buffer than the RMT queue can hold
+// Only the refresh timer touches the buffers, Set_Servo writes dshot_next
+typedef struct Servo_Channel{
+    servo_backend_t backend;
+    uint32_t period_ticks;
+    mcpwm_cmpr_handle_t cmp;
+    ledc_channel_t ledc_ch;
+    rmt_channel_handle_t rmt_ch;
+    rmt_encoder_handle_t rmt_enc;
+    uint8_t dshot_frame[SERVO_DSHOT_QUEUE_DEPTH + 1][2];
+    uint8_t dshot_frame_idx;
+    volatile uint16_t dshot_next;               // Frame the refresh timer sends next
+    int16_t position;                           // Last commanded degrees
+} servo_channel_t;
+
+
 // Global to this file
-// Handles for timer comparators to generate PWM
-static mcpwm_cmpr_handle_t servo1_cmp = NULL;
-static mcpwm_cmpr_handle_t servo2_cmp = NULL;
+static const servo_protocol_t servo_protocols[SERVO_NUM_PROTOS] = {
+    [SERVO_PROTO_PWM50]      = { SERVO_RES_HZ,         SERVO_PERIOD },
+    [SERVO_PROTO_PWM333]     = { SERVO_RES_HZ,         SERVO_PERIOD_333 },
+    [SERVO_PROTO_ONESHOT125] = { SERVO_RES_HZ_ONESHOT, SERVO_PERIOD_ONESHOT },
+    [SERVO_PROTO_DSHOT300]   = { SERVO_DSHOT_RES_HZ,   DSHOT300_BIT },
+    [SERVO_PROTO_DSHOT600]   = { SERVO_DSHOT_RES_HZ,   DSHOT600_BIT },
+};
+static servo_channel_t servo_channels[CFG_NUM_SERVOS];
+static esp_timer_handle_t servo_dshot_timer = NULL;
 static const char* SERVO_TAG = "Servo";
 
 
-// Init Servos
-void Init_Servos(void){
+// Servo_Reserved_Pins
+// Builds a bitmask of GPIO used elsewhere in the project
+// Flash pins 6 - 11 are always reserved
+static uint64_t Servo_Reserved_Pins(void){
+    uint64_t mask = 0;
+    uint8_t i;
+    for(i = 6; i <= 11; i++){
+        mask |= 1ULL << i;
+    }
+    mask |= 1ULL << LED1_PIN;
+    mask |= 1ULL << LED2_PIN;
+    mask |= 1ULL << GPS_UART_TX_PIN;
+    mask |= 1ULL << GPS_UART_RX_PIN;
+    if(Config_Get()->gps_pps_pin >= 0) mask |= 1ULL << Config_Get()->gps_pps_pin;
+    return mask;
+}
+
+
+// Init_Servo_MCPWM
+// Creates a timer, operator, comparator and generator for one channel
+// Takes MCPWM group, output pin, protocol, and pointer to the channel handle to fill
+static void Init_Servo_MCPWM(int group, int pin, uint8_t protocol, servo_channel_t *ch){
     // Create timer
     mcpwm_timer_handle_t servo_tmr = NULL;
     mcpwm_timer_config_t servo_tmr_config = {
-        .group_id = 0,
+        .group_id = group,
         .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
-        .resolution_hz = SERVO_RES_HZ,
-        .period_ticks = SERVO_PERIOD,
+        .resolution_hz = servo_protocols[protocol].resolution_hz,
+        .period_ticks = servo_protocols[protocol].period_ticks,
         .count_mode = MCPWM_TIMER_COUNT_MODE_UP,
     };
     ESP_ERROR_CHECK(mcpwm_new_timer(&servo_tmr_config, &servo_tmr));
@@ -44,50 +114,210 @@ void Init_Servos(void){
     // Create operator
     mcpwm_oper_handle_t servo_oper = NULL;
     mcpwm_operator_config_t servo_oper_config = {
-        .group_id = 0,
+        .group_id = group,
     };
     ESP_ERROR_CHECK(mcpwm_new_operator(&servo_oper_config, &servo_oper));
 
     // Connect timer to operator
     ESP_ERROR_CHECK(mcpwm_operator_connect_timer(servo_oper, servo_tmr));
 
-    // Create two comparators, one for servo 1 value, one for servo 2 value
-    mcpwm_comparator_config_t servo1_cmp_config = {
+    // Create comparator
+    mcpwm_comparator_config_t servo_cmp_config = {
         .flags.update_cmp_on_tez = true,
     };
-    mcpwm_comparator_config_t servo2_cmp_config = {
-        .flags.update_cmp_on_tez = true,
-    };
-    ESP_ERROR_CHECK(mcpwm_new_comparator(servo_oper, &servo1_cmp_config, &servo1_cmp));
-    ESP_ERROR_CHECK(mcpwm_new_comparator(servo_oper, &servo2_cmp_config, &servo2_cmp));
-
-    // Create PWM generator for each servo
-    mcpwm_gen_handle_t servo1_gen = NULL;
-    mcpwm_gen_handle_t servo2_gen = NULL;
-    mcpwm_generator_config_t servo1_gen_config = {
-        .gen_gpio_num = SERVO_1_PIN,
-    };
-    mcpwm_generator_config_t servo2_gen_config = {
-        .gen_gpio_num = SERVO_2_PIN,
-    };
-    ESP_ERROR_CHECK(mcpwm_new_generator(servo_oper, &servo1_gen_config, &servo1_gen));
-    ESP_ERROR_CHECK(mcpwm_new_generator(servo_oper, &servo2_gen_config, &servo2_gen));
+    ESP_ERROR_CHECK(mcpwm_new_comparator(servo_oper, &servo_cmp_config, &ch->cmp));
 
-    // Set the initial servo positions to centered
-    ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(servo1_cmp, Map_Servo_Deg_PWM(0)));
-    ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(servo2_cmp, Map_Servo_Deg_PWM(0)));
+    // Create PWM generator
+    mcpwm_gen_handle_t servo_gen = NULL;
+    mcpwm_generator_config_t servo_gen_config = {
+        .gen_gpio_num = pin,
+    };
+    ESP_ERROR_CHECK(mcpwm_new_generator(servo_oper, &servo_gen_config, &servo_gen));
 
     // Set PWM generator actions on comparator events
     // Go high on timer empty/top (same event really)
-    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_timer_event(servo1_gen, MCPWM_GEN_TIMER_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY, MCPWM_GEN_ACTION_HIGH)));
-    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_timer_event(servo2_gen, MCPWM_GEN_TIMER_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY, MCPWM_GEN_ACTION_HIGH)));
+    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_timer_event(servo_gen, MCPWM_GEN_TIMER_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY, MCPWM_GEN_ACTION_HIGH)));
     // Set low when timer reaches compare value
-    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_compare_event(servo1_gen, MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, servo1_cmp, MCPWM_GEN_ACTION_LOW)));
-    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_compare_event(servo2_gen, MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, servo2_cmp, MCPWM_GEN_ACTION_LOW)));
+    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_compare_event(servo_gen, MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, ch->cmp, MCPWM_GEN_ACTION_LOW)));
 
-    // Enable and start timers
+    // Enable and start timer
     ESP_ERROR_CHECK(mcpwm_timer_enable(servo_tmr));
     ESP_ERROR_CHECK(mcpwm_timer_start_stop(servo_tmr, MCPWM_TIMER_START_NO_STOP));
+
+    ch->backend = SERVO_BACKEND_MCPWM;
+}
+
+
+// Init_Servo_LEDC
+// Attaches one channel to the LEDC timer of its protocol
+// The LEDC timer number is the protocol number, only PWM / OneShot protocols are valid
+// Takes LEDC channel number, output pin, protocol, and pointer to the channel handle to fill
+static void Init_Servo_LEDC(ledc_channel_t ledc_ch, int pin, uint8_t protocol, servo_channel_t *ch){
+    ledc_channel_config_t servo_ledc_config = {
+        .gpio_num = pin,
+        .speed_mode = SERVO_LEDC_MODE,
+        .channel = ledc_ch,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = (ledc_timer_t) protocol,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    ESP_ERROR_CHECK(ledc_channel_config(&servo_ledc_config));
+
+    ch->ledc_ch = ledc_ch;
+    ch->backend = SERVO_BACKEND_LEDC;
+}
+
+
+// Init_Servo_RMT
+// Creates an RMT TX channel and a bytes encoder with DShot bit timings
+// Takes output pin, protocol, and pointer to the channel handle to fill
+static void Init_Servo_RMT(int pin, uint8_t protocol, servo_channel_t *ch){
+    uint16_t t1h = (protocol == SERVO_PROTO_DSHOT600) ? DSHOT600_T1H : DSHOT300_T1H;
+    uint16_t t0h = (protocol == SERVO_PROTO_DSHOT600) ? DSHOT600_T0H : DSHOT300_T0H;
+    uint16_t bit = (uint16_t) servo_protocols[protocol].period_ticks;
+
+    rmt_tx_channel_config_t servo_rmt_config = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = SERVO_DSHOT_RES_HZ,
+        .mem_block_symbols = 64,
+        .trans_queue_depth = SERVO_DSHOT_QUEUE_DEPTH,
+    };
+    ESP_ERROR_CHECK(rmt_new_tx_channel(&servo_rmt_config, &ch->rmt_ch));
+
+    rmt_bytes_encoder_config_t servo_enc_config = {
+        .bit0 = { .level0 = 1, .duration0 = t0h, .level1 = 0, .duration1 = bit - t0h },
+        .bit1 = { .level0 = 1, .duration0 = t1h, .level1 = 0, .duration1 = bit - t1h },
+        .flags.msb_first = 1,
+    };
+    ESP_ERROR_CHECK(rmt_new_bytes_encoder(&servo_enc_config, &ch->rmt_enc));
+    ESP_ERROR_CHECK(rmt_enable(ch->rmt_ch));
+
+    ch->dshot_frame_idx = 0;
+    ch->backend = SERVO_BACKEND_RMT;
+}
+
+
+// Servo_DShot_Refresh
+// esp_timer callback, queues the latest frame of every DShot channel on its RMT
+// At SERVO_DSHOT_REFRESH_HZ a frame is long sent before the next, so the RMT
+// queue never fills and rmt_transmit does not block
+static void Servo_DShot_Refresh(void *args){
+    servo_channel_t *ch;
+    uint8_t *buf;
+    uint16_t frame;
+    uint8_t i;
+    rmt_transmit_config_t tx_config = {
+        .loop_count = 0,
+    };
+
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        ch = &servo_channels[i];
+        if(ch->backend != SERVO_BACKEND_RMT) continue;
+        frame = ch->dshot_next;
+        buf = ch->dshot_frame[ch->dshot_frame_idx];
+        buf[0] = frame >> 8;
+        buf[1] = frame & 0xFF;
+        ch->dshot_frame_idx = (ch->dshot_frame_idx + 1) % (SERVO_DSHOT_QUEUE_DEPTH + 1);
+        ESP_ERROR_CHECK(rmt_transmit(ch->rmt_ch, ch->rmt_enc, buf, sizeof(ch->dshot_frame[0]), &tx_config));
+    }
+}
+
+
+// Init Servos
+// Allocates a hardware channel for every enabled entry in the servo table
+// Channels with a pin that is invalid, reserved, or already used are left disabled
+void Init_Servos(void){
+    const laelaps_config_t *cfg = Config_Get();
+    uint64_t used_pins = Servo_Reserved_Pins();
+    uint8_t num_mcpwm = 0;
+    uint8_t num_ledc = 0;
+    uint8_t num_rmt = 0;
+    uint8_t ledc_tmr_ready = 0;
+    uint8_t protocol;
+    uint8_t i;
+    int pin;
+
+    // LEDC timers are shared by all fallback channels of the same protocol
+    ledc_timer_config_t servo_ledc_tmr_config = {
+        .speed_mode = SERVO_LEDC_MODE,
+        .duty_resolution = SERVO_LEDC_RES_BITS,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        servo_channels[i].backend = SERVO_BACKEND_NONE;
+        pin = cfg->servo[i].pin;
+        protocol = cfg->servo[i].protocol;
+        if(pin == CFG_SERVO_UNUSED) continue;
+
+        // Pin conflict detection
+        if(!GPIO_IS_VALID_OUTPUT_GPIO(pin)){
+            ESP_LOGE(SERVO_TAG, "Servo %d: GPIO %d is not an output", i, pin);
+            continue;
+        }
+        if(used_pins & (1ULL << pin)){
+            ESP_LOGE(SERVO_TAG, "Servo %d: GPIO %d already in use", i, pin);
+            continue;
+        }
+
+        if(Servo_Is_DShot(protocol)){
+            if(num_rmt >= SERVO_RMT_CHANNELS){
+                ESP_LOGE(SERVO_TAG, "Servo %d: no free RMT channel", i);
+                continue;
+            }
+            Init_Servo_RMT(pin, protocol, &servo_channels[i]);
+            num_rmt++;
+        }
+        else if(num_mcpwm < SERVO_MCPWM_CHANNELS){
+            Init_Servo_MCPWM(num_mcpwm / SERVO_MCPWM_PER_GROUP, pin, protocol, &servo_channels[i]);
+            num_mcpwm++;
+        }
+        else if(num_ledc < SERVO_LEDC_CHANNELS){
+            if(!(ledc_tmr_ready & (1 << protocol))){
+                servo_ledc_tmr_config.timer_num = (ledc_timer_t) protocol;
+                servo_ledc_tmr_config.freq_hz = servo_protocols[protocol].resolution_hz / servo_protocols[protocol].period_ticks;
+                ESP_ERROR_CHECK(ledc_timer_config(&servo_ledc_tmr_config));
+                ledc_tmr_ready |= 1 << protocol;
+            }
+            Init_Servo_LEDC((ledc_channel_t) num_ledc, pin, protocol, &servo_channels[i]);
+            num_ledc++;
+        }
+        else{
+            ESP_LOGE(SERVO_TAG, "Servo %d: no free PWM channel", i);
+            continue;
+        }
+        used_pins |= 1ULL << pin;
+        servo_channels[i].period_ticks = servo_protocols[protocol].period_ticks;
+
+        // Set the initial servo position to centered, ESCs start stopped
+        if(Servo_Is_DShot(protocol)) Set_Servo(i, cfg->servo[i].min_deg);
+        else Set_Servo(i, (cfg->servo[i].min_deg + cfg->servo[i].max_deg) / 2);
+    }
+
+    // Every DShot channel has its first frame, start streaming them
+    if(num_rmt){
+        esp_timer_create_args_t dshot_timer_args = {
+            .callback = Servo_DShot_Refresh,
+            .name = "dshot",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&dshot_timer_args, &servo_dshot_timer));
+        ESP_ERROR_CHECK(esp_timer_start_periodic(servo_dshot_timer, 1000000 / SERVO_DSHOT_REFRESH_HZ));
+    }
+
+    ESP_LOGI(SERVO_TAG, "%d MCPWM, %d LEDC, %d RMT channels", num_mcpwm, num_ledc, num_rmt);
+}
+
+
+// Set_DShot
+// Builds one 16 bit DShot frame for the refresh timer to send from now on
+// Frame is 11 bit throttle, telemetry request bit (always 0), 4 bit checksum
+static void Set_DShot(servo_channel_t *ch, uint16_t throttle){
+    uint16_t frame = throttle << 1;
+
+    frame = (frame << 4) | ((frame ^ (frame >> 4) ^ (frame >> 8)) & 0x0F);
+    ch->dshot_next = frame;                     // One aligned store, the timer never sees half a frame
 }
 
 
@@ -96,24 +326,35 @@ void Init_Servos(void){
 // Takes uint8_t servo number, and int16_t servo position
 // Does not return anything
 void Set_Servo(uint8_t servo, int16_t position){
+    const laelaps_config_t *cfg = Config_Get();
+    servo_channel_t *ch;
     uint16_t compare_value;
     // Input validation
-    if ((position < SERVO_MIN_DEG) || (position > SERVO_MAX_DEG)){
+    if(servo >= CFG_NUM_SERVOS){
+        return;
+    }
+    if ((position < cfg->servo[servo].min_deg) || (position > cfg->servo[servo].max_deg)){
         ESP_LOGI(SERVO_TAG, "%d invalid angle", position);
         return;
     }
 
-    // If data good, set servos
-    compare_value = Map_Servo_Deg_PWM(position);
-    switch(servo){
-    case 0:
-        ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(servo1_cmp, compare_value));
-        //ESP_LOGI(SERVO_TAG, "Set Servo 1 %d ms", compare_value);
+    // If data good, set servo
+    ch = &servo_channels[servo];
+    ch->position = position;
+    if(ch->backend == SERVO_BACKEND_RMT){
+        Set_DShot(ch, Map_Servo_Deg_DShot(servo, position));
+        return;
+    }
+    compare_value = Map_Servo_Deg_PWM(servo, position);
+    switch(ch->backend){
+    case SERVO_BACKEND_MCPWM:
+        ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(ch->cmp, compare_value));
     break;
 
-    case 1:
-        ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(servo2_cmp, compare_value));
-        //ESP_LOGI(SERVO_TAG, "Set Servo 2 %d ms", compare_value);
+    case SERVO_BACKEND_LEDC:
+        // Convert pulse width in timer ticks to duty counts of one period
+        ESP_ERROR_CHECK(ledc_set_duty(SERVO_LEDC_MODE, ch->ledc_ch, ((uint32_t) compare_value << SERVO_LEDC_RES_BITS) / ch->period_ticks));
+        ESP_ERROR_CHECK(ledc_update_duty(SERVO_LEDC_MODE, ch->ledc_ch));
     break;
 
     default:
@@ -122,17 +363,58 @@ void Set_Servo(uint8_t servo, int16_t position){
 }
 
 
+// Get_Servo_Position
+// Returns the last position commanded with Set_Servo, 0 for unused channels
+int16_t Get_Servo_Position(uint8_t servo){
+    if(servo >= CFG_NUM_SERVOS) return 0;
+    return servo_channels[servo].position;
+}
+
+
+// Servo_Is_DShot
+// Returns TRUE if the protocol is generated by RMT
+uint8_t Servo_Is_DShot(uint8_t protocol){
+    return SERVO_IS_DSHOT(protocol);
+}
+
+
+// Servo_Period_Ticks
+// Returns the PWM period of a protocol in timer ticks
+// Pulse widths from Map_Servo_Deg_PWM must stay below this
+uint32_t Servo_Period_Ticks(uint8_t protocol){
+    if(protocol >= SERVO_NUM_PROTOS) return 0;
+    return servo_protocols[protocol].period_ticks;
+}
+
+
+// Map_Servo_Deg_DShot
+// This function maps a position to a DShot throttle value
+// Lowest angle is motor stop, anything above is linear over 48 - 2047
+uint16_t Map_Servo_Deg_DShot(uint8_t servo, int16_t degrees){
+    const servo_channel_config_t *sc = &Config_Get()->servo[servo];
+    if(degrees <= sc->min_deg){
+        return SERVO_DSHOT_STOP;
+    }
+    if(degrees > sc->max_deg){
+        degrees = sc->max_deg;
+    }
+    return (uint16_t) ((int32_t) (degrees - sc->min_deg) * (SERVO_DSHOT_MAX - SERVO_DSHOT_MIN) / (sc->max_deg - sc->min_deg) + SERVO_DSHOT_MIN);
+}
+
+
 // Map_Servo_Deg_PWM
 // This function maps a servo position to a PWM pulsewidth
-// Takes angle in degrees, returns pulse high time in us
-uint16_t Map_Servo_Deg_PWM(int16_t degrees){
+// Takes servo number and angle in degrees, returns pulse high time in us
+// For OneShot125 the timer runs 8x faster, so the same value is 1/8 the time
+uint16_t Map_Servo_Deg_PWM(uint8_t servo, int16_t degrees){
+    const servo_channel_config_t *sc = &Config_Get()->servo[servo];
     int32_t micro_seconds;
     // Input validation
-    if((degrees < SERVO_MIN_DEG) || (degrees > SERVO_MAX_DEG)){
-        return (SERVO_MIN_US + SERVO_MAX_US) / 2;
+    if((degrees < sc->min_deg) || (degrees > sc->max_deg)){
+        return (sc->min_us + sc->max_us) / 2;
     }
 
     // If angle good, map to number of microseconds
-    micro_seconds = (degrees - SERVO_MIN_DEG) * (SERVO_MAX_US - SERVO_MIN_US) / (SERVO_MAX_DEG - SERVO_MIN_DEG)  + SERVO_MIN_US;
+    micro_seconds = (degrees - sc->min_deg) * (sc->max_us - sc->min_us) / (sc->max_deg - sc->min_deg)  + sc->min_us;
     return (uint16_t) micro_seconds;
-}
\ No newline at end of file
+}
@@ -4,13 +4,15 @@ This file holds the macro definitions for servo.h
 Author:         James Sorber
 Contact:        jrsorber@ncsu.edu
 Created:        8/30/2024
-Modified:       -
+Modified:       10/19/2026
 Last Built With ESP-IDF v5.2.2
 */
 
 #ifndef SERVO_H
 #define SERVO_H
 
+// Default pins, used when no configuration is stored in NVS
+// The number of channels is CFG_NUM_SERVOS in config.h
 #define SERVO_1_PIN     12
 #define SERVO_2_PIN     14
 
@@ -21,4 +23,48 @@ Last Built With ESP-IDF v5.2.2
 #define SERVO_PERIOD    20000
 #define SERVO_RES_HZ    1000000
 
-#endif
\ No newline at end of file
+// Output protocols, selectable per channel
+// PWM and OneShot protocols take pulse widths in us from the channel limits
+// OneShot125 runs the timer 8x faster so 1000 - 2000 us becomes 125 - 250 us
+// DShot maps the lowest angle to motor stop and the rest to throttle 48 - 2047
+#define SERVO_PROTO_PWM50       0
+#define SERVO_PROTO_PWM333      1
+#define SERVO_PROTO_ONESHOT125  2
+#define SERVO_PROTO_DSHOT300    3
+#define SERVO_PROTO_DSHOT600    4
+#define SERVO_NUM_PROTOS        5
+#define SERVO_IS_DSHOT(p)       (((p) == SERVO_PROTO_DSHOT300) || ((p) == SERVO_PROTO_DSHOT600))
+
+#define SERVO_PERIOD_333        3000
+#define SERVO_RES_HZ_ONESHOT    8000000
+#define SERVO_PERIOD_ONESHOT    4000
+
+// DShot frame generation on RMT
+// Bit timings in RMT ticks at SERVO_DSHOT_RES_HZ
+#define SERVO_RMT_CHANNELS      8
+#define SERVO_DSHOT_RES_HZ      40000000
+#define SERVO_DSHOT_QUEUE_DEPTH 2
+#define SERVO_DSHOT_REFRESH_HZ  1000            // ESCs disarm without a steady stream of frames
+#define SERVO_DSHOT_STOP        0
+#define SERVO_DSHOT_MIN         48
+#define SERVO_DSHOT_MAX         2047
+#define DSHOT300_T1H            100
+#define DSHOT300_T0H            50
+#define DSHOT300_BIT            133
+#define DSHOT600_T1H            50
+#define DSHOT600_T0H            25
+#define DSHOT600_BIT            67
+
+// Hardware channel allocation
+// Each MCPWM channel gets its own timer, operator and comparator
+// ESP32 has 2 MCPWM groups with 3 timers / operators each
+// Channels past the MCPWM limit are generated by LEDC, one LEDC timer per protocol
+// DShot channels always use RMT and do not count against MCPWM or LEDC
+#define SERVO_MCPWM_GROUPS      2
+#define SERVO_MCPWM_PER_GROUP   3
+#define SERVO_MCPWM_CHANNELS    (SERVO_MCPWM_GROUPS * SERVO_MCPWM_PER_GROUP)
+#define SERVO_LEDC_CHANNELS     8
+#define SERVO_LEDC_MODE         LEDC_LOW_SPEED_MODE
+#define SERVO_LEDC_RES_BITS     14
+
+#endif
@@ -1,218 +1,494 @@
-/* BSD non-blocking socket example
+/* Non-blocking TCP client for telemetry
 
-   This example code is in the Public Domain (or CC0 licensed, at your option.)
+   Adapted from the ESP-IDF BSD non-blocking socket example
+   (Public Domain / CC0). Producers queue whole frames into a bounded
+   per-connection TX queue and never block on the network. A low
+   priority client task owns the socket, waits for it with select()
+   and flushes the queue with writev(). The queue itself is in
+   tcp_conn.c, which the host tools build too.
 
-   Unless required by applicable law or agreed to in writing, this
-   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
-   CONDITIONS OF ANY KIND, either express or implied.
+   In fleet mode several vehicles share one AP. Each one only flushes at
+   the start of its own slot of a GPS time aligned frame, so their bursts
+   do not contend for the channel.
 */
 #include <string.h>
+#include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "sys/socket.h"
+#include "lwip/sockets.h"
 #include "netdb.h"
 #include "errno.h"
 #include "esp_system.h"
-#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
-#include "protocol_examples_common.h"
+#include "config.h"
+#include "tcp_client.h"
+#include "telemetry.h"
+#include "health.h"
+#include "time_sync.h"
+#include "functions.h"
 
-/**
- * @brief Indicates that the file descriptor represents an invalid (uninitialized or closed) socket
- *
- * Used in the TCP server structure `sock[]` which holds list of active clients we serve.
- */
-#define INVALID_SOCK (-1)
+_Static_assert(TCP_RESOLVE_MAX_MS < HEALTH_TWDT_TIMEOUT_MS, "A name lookup would trip the task watchdog");
 
-/**
- * @brief Time in ms to yield to all tasks when a non-blocking socket would block
- *
- * Non-blocking socket operations are typically executed in a separate task validating
- * the socket status. Whenever the socket returns `EAGAIN` (idle status, i.e. would block)
- * we have to yield to all tasks to prevent lower priority tasks from starving.
- */
-#define YIELD_TO_ALL_MS 50
+static const char *TAG = "tcp_client";
+
+/* Telemetry connection to the ground station */
+static tcp_conn_t s_tlm_conn;
+static uint16_t s_unit_id = 0;
+static esp_timer_handle_t s_slot_timer = NULL;
+static TaskHandle_t s_client_task = NULL;
+
+/* Configuration update from the ground station, patched in place until committed */
+static laelaps_config_t s_cfg_staged;
+static uint8_t s_cfg_staging = 0;
+static esp_err_t s_cfg_err = ESP_OK;
+
+static void tcp_slot_timer_cb(void *args);
 
 /**
- * @brief Utility to log socket errors
+ * @brief Turns the server name or address into a socket address
+ *
+ * Numeric addresses, which is what the configuration holds, are parsed in place.
+ * Only names go through getaddrinfo, which allocates its result on the heap.
  *
  * @param[in] tag Logging tag
- * @param[in] sock Socket number
- * @param[in] err Socket errno
- * @param[in] message Message to print
+ * @param[in] host Server name or address
+ * @param[in] port Server port
+ * @param[out] addr Socket address
+ * @param[out] addr_len Length of the socket address
+ * @return 0 on success, -1 if the name could not be resolved
  */
-static void log_socket_error(const char *tag, const int sock, const int err, const char *message)
+static int tcp_resolve(const char *tag, const char *host, uint16_t port, struct sockaddr_storage *addr, socklen_t *addr_len)
 {
-    ESP_LOGE(tag, "[sock=%d]: %s\n"
-                  "error=%d: %s", sock, message, err, strerror(err));
+    struct sockaddr_in *addr4 = (struct sockaddr_in *)addr;
+    struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
+    struct addrinfo *address_info = NULL;
+    char port_str[6];
+    int res;
+
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+    if (inet_pton(AF_INET, host, &addr4->sin_addr) == 1) {
+        addr4->sin_family = AF_INET;
+        addr4->sin_port = htons(port);
+        *addr_len = sizeof(struct sockaddr_in);
+        return 0;
+    }
+#if CONFIG_LWIP_IPV6
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)addr;
+    if (inet_pton(AF_INET6, host, &addr6->sin6_addr) == 1) {
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        *addr_len = sizeof(struct sockaddr_in6);
+        return 0;
+    }
+#endif
+
+    snprintf(port_str, sizeof(port_str), "%u", port);
+    res = getaddrinfo(host, port_str, &hints, &address_info);
+    if (res != 0 || address_info == NULL) {
+        ESP_LOGE(tag, "couldn't get hostname for `%s` "
+                      "getaddrinfo() returns %d, addrinfo=%p", host, res, address_info);
+        return -1;
+    }
+    memcpy(addr, address_info->ai_addr, address_info->ai_addrlen);
+    *addr_len = address_info->ai_addrlen;
+    freeaddrinfo(address_info);
+    return 0;
 }
 
 /**
- * @brief Tries to receive data from specified sockets in a non-blocking way,
- *        i.e. returns immediately if no data.
+ * @brief Opens a non-blocking TCP connection, waiting at most TCP_CONNECT_TIMEOUT_MS
+ *
+ * Waits in TCP_CONNECT_SLICE_MS slices and beats for the calling task in between,
+ * so a slow server never trips the task watchdog.
  *
  * @param[in] tag Logging tag
- * @param[in] sock Socket for reception
- * @param[out] data Data pointer to write the received data
- * @param[in] max_len Maximum size of the allocated space for receiving data
- * @return
- *          >0 : Size of received data
- *          =0 : No data available
- *          -1 : Error occurred during socket read operation
- *          -2 : Socket is not connected, to distinguish between an actual socket error and active disconnection
+ * @param[in] host_cfg Server name or address
+ * @param[in] port Server port
+ * @param[in] health_id Calling task's Health_Register id
+ * @return Connected socket, or INVALID_SOCK
  */
-static int try_receive(const char *tag, const int sock, char * data, size_t max_len)
+static int tcp_connect(const char *tag, const char *host_cfg, uint16_t port, int8_t health_id)
 {
-    int len = recv(sock, data, max_len, 0);
-    if (len < 0) {
-        if (errno == EINPROGRESS || errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 0;   // Not an error
+    char host[CFG_HOST_MAX_LEN + 1];
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    struct timeval timeout;
+    uint32_t waited_ms;
+    int sock = INVALID_SOCK;
+    int res;
+
+    // Callers pass the name straight from the configuration, which may be updated while this blocks
+    strncpy(host, host_cfg, CFG_HOST_MAX_LEN);
+    host[CFG_HOST_MAX_LEN] = '\0';
+    res = tcp_resolve(tag, host, port, &addr, &addr_len);
+    Health_Beat(health_id);
+    if (res != 0) {
+        return INVALID_SOCK;
+    }
+
+    sock = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (sock < 0) {
+        Tcp_Log_Socket_Error(tag, sock, errno, "Unable to create socket");
+        sock = INVALID_SOCK;
+        goto error;
+    }
+
+    // Marking the socket as non-blocking
+    int flags = fcntl(sock, F_GETFL);
+    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
+        Tcp_Log_Socket_Error(tag, sock, errno, "Unable to set socket non blocking");
+        goto error;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, addr_len) != 0) {
+        if (errno != EINPROGRESS) {
+            Tcp_Log_Socket_Error(tag, sock, errno, "Socket is unable to connect");
+            goto error;
         }
-        if (errno == ENOTCONN) {
-            ESP_LOGW(tag, "[sock=%d]: Connection closed", sock);
-            return -2;  // Socket has been disconnected
+
+        // Connection in progress -> wait until the socket is writable, i.e. connection completes
+        fd_set fdset;
+        res = 0;
+        for (waited_ms = 0; res == 0 && waited_ms < TCP_CONNECT_TIMEOUT_MS; waited_ms += TCP_CONNECT_SLICE_MS) {
+            Health_Beat(health_id);
+            FD_ZERO(&fdset);
+            FD_SET(sock, &fdset);
+            timeout.tv_sec = 0;
+            timeout.tv_usec = TCP_CONNECT_SLICE_MS * 1000;
+            res = select(sock + 1, NULL, &fdset, NULL, &timeout);
+        }
+        if (res <= 0) {
+            Tcp_Log_Socket_Error(tag, sock, errno, res < 0 ? "Error during connection: select for socket to be writable"
+                                                       : "Connection timeout: select for socket to be writable");
+            goto error;
+        }
+
+        int sockerr;
+        socklen_t len = (socklen_t)sizeof(int);
+        if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (void*)(&sockerr), &len) < 0) {
+            Tcp_Log_Socket_Error(tag, sock, errno, "Error when getting socket error using getsockopt()");
+            goto error;
+        }
+        if (sockerr) {
+            Tcp_Log_Socket_Error(tag, sock, sockerr, "Connection error");
+            goto error;
         }
-        log_socket_error(tag, sock, errno, "Error occurred during receiving");
-        return -1;
     }
 
-    return len;
+    ESP_LOGI(tag, "[sock=%d]: Connected to %s:%u", sock, host, port);
+    return sock;
+
+error:
+    if (sock != INVALID_SOCK) {
+        close(sock);
+    }
+    return INVALID_SOCK;
 }
 
 /**
- * @brief Sends the specified data to the socket. This function blocks until all bytes got sent.
+ * @brief Connects a closed connection, waiting at most TCP_CONNECT_TIMEOUT_MS
+ *
+ * For connections owned by other tasks than the telemetry client.
  *
+ * @param[in] conn Connection
  * @param[in] tag Logging tag
- * @param[in] sock Socket to write data
- * @param[in] data Data to be written
- * @param[in] len Length of the data
- * @return
- *          >0 : Size the written data
- *          -1 : Error occurred during socket write operation
+ * @param[in] host Server name or address
+ * @param[in] port Server port
+ * @param[in] health_id Calling task's Health_Register id, beaten while connecting
+ * @return 0 on success, TCP_ERR if the server could not be reached
  */
-static int socket_send(const char *tag, const int sock, const char * data, const size_t len)
+int Tcp_Conn_Open(tcp_conn_t *conn, const char *tag, const char *host, uint16_t port, int8_t health_id)
 {
-    int to_write = len;
-    while (to_write > 0) {
-        int written = send(sock, data + (len - to_write), to_write, 0);
-        if (written < 0 && errno != EINPROGRESS && errno != EAGAIN && errno != EWOULDBLOCK) {
-            log_socket_error(tag, sock, errno, "Error occurred during sending");
-            return -1;
-        }
-        to_write -= written;
+    int sock = tcp_connect(tag, host, port, health_id);
+
+    if (sock == INVALID_SOCK) {
+        return TCP_ERR;
     }
-    return len;
+    Tcp_Conn_Attach(conn, sock);
+    return 0;
 }
 
+/**
+ * @brief Queues one telemetry frame on the ground station connection
+ *
+ * @param[in] type TLM_TYPE_ frame type
+ * @param[in] payload Frame payload
+ * @param[in] len Payload length
+ * @return Same as Tcp_Conn_Send_Vec. On TCP_ERR_BACKPRESSURE the producer should decimate
+ */
+int Telemetry_Send(uint8_t type, const void *payload, uint16_t len)
+{
+    return Tcp_Conn_Send_Frame(&s_tlm_conn, type, payload, len);
+}
 
-#ifdef CONFIG_EXAMPLE_TCP_CLIENT
+/**
+ * @brief Returns the telemetry connection, for statistics
+ */
+const tcp_conn_t *Get_Telemetry_Conn(void)
+{
+    return &s_tlm_conn;
+}
 
-static void tcp_client_task(void *pvParameters)
+/**
+ * @brief Returns the ID this unit stamps into its telemetry frames
+ */
+uint16_t Get_Unit_ID(void)
 {
-    static const char *TAG = "nonblocking-socket-client";
-    static const char *payload = "GET / HTTP/1.1\r\n\r\n";
-    static char rx_buffer[128];
+    return s_unit_id;
+}
 
-    struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
-    struct addrinfo *address_info;
-    int sock = INVALID_SOCK;
+/**
+ * @brief Must be called before any task uses Telemetry_Send
+ *
+ * Resolves the unit ID: the configured one, or else the last two bytes of the
+ * factory MAC, which are unique enough within one fleet.
+ */
+void Init_Tcp_Client(void)
+{
+    uint8_t mac[6];
 
-    int res = getaddrinfo(CONFIG_EXAMPLE_TCP_CLIENT_CONNECT_ADDRESS, CONFIG_EXAMPLE_TCP_CLIENT_CONNECT_PORT, &hints, &address_info);
-    if (res != 0 || address_info == NULL) {
-        ESP_LOGE(TAG, "couldn't get hostname for `%s` "
-                      "getaddrinfo() returns %d, addrinfo=%p", CONFIG_EXAMPLE_TCP_CLIENT_CONNECT_ADDRESS, res, address_info);
-        goto error;
+    Tcp_Conn_Init(&s_tlm_conn);
+
+    // Created here, esp_timer_create allocates
+    esp_timer_create_args_t slot_timer_args = {
+        .callback = tcp_slot_timer_cb,
+        .name = "tlm_slot",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&slot_timer_args, &s_slot_timer));
+
+    s_unit_id = Config_Get()->unit_id;
+    if (s_unit_id == 0) {
+        ESP_ERROR_CHECK(esp_efuse_mac_get_default(mac));
+        s_unit_id = ((uint16_t)mac[4] << 8) | mac[5];
     }
+    s_tlm_conn.unit_id = s_unit_id;
+    ESP_LOGI(TAG, "Unit ID %u", s_unit_id);
+}
 
-    // Creating client's socket
-    sock = socket(address_info->ai_family, address_info->ai_socktype, address_info->ai_protocol);
-    if (sock < 0) {
-        log_socket_error(TAG, sock, errno, "Unable to create socket");
-        goto error;
+/**
+ * @brief Applies one config frame from the ground station
+ *
+ * Patches a copy of the active configuration. The frame with TLM_CONFIG_COMMIT publishes
+ * it with Config_Update, from this task, and is acked with the result. A bad patch fails
+ * the whole update at its commit.
+ *
+ * @param[in] conn Connection the frame came on, the ack goes back on it
+ * @param[in] payload Frame payload
+ * @param[in] len Payload length
+ * @param[in] health_id Calling task's Health_Register id, beaten while the update waits
+ */
+static void tcp_handle_config(tcp_conn_t *conn, const uint8_t *payload, uint16_t len, int8_t health_id)
+{
+    tlm_config_ack_t ack;
+    tlm_config_t patch;
+    uint16_t data_len;
+
+    if (len < sizeof(patch)) {
+        return;
     }
-    ESP_LOGI(TAG, "Socket created, connecting to %s:%s", CONFIG_EXAMPLE_TCP_CLIENT_CONNECT_ADDRESS, CONFIG_EXAMPLE_TCP_CLIENT_CONNECT_PORT);
+    memcpy(&patch, payload, sizeof(patch));
+    data_len = len - sizeof(patch);
 
-    // Marking the socket as non-blocking
-    int flags = fcntl(sock, F_GETFL);
-    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
-        log_socket_error(TAG, sock, errno, "Unable to set socket non blocking");
+    if (patch.flags & TLM_CONFIG_BEGIN) {
+        memcpy(&s_cfg_staged, Config_Get(), sizeof(laelaps_config_t));
+        s_cfg_staging = 1;
+        s_cfg_err = ESP_OK;
+    }
+    if (!s_cfg_staging) {
+        s_cfg_err = ESP_ERR_INVALID_STATE;
+    } else if (patch.schema_version != CFG_SCHEMA_VERSION
+               || (uint32_t)patch.offset + data_len > sizeof(laelaps_config_t)) {
+        s_cfg_err = ESP_ERR_INVALID_ARG;
+    } else if (s_cfg_err == ESP_OK) {
+        memcpy((uint8_t *)&s_cfg_staged + patch.offset, &payload[sizeof(patch)], data_len);
     }
 
-    if (connect(sock, address_info->ai_addr, address_info->ai_addrlen) != 0) {
-        if (errno == EINPROGRESS) {
-            ESP_LOGD(TAG, "connection in progress");
-            fd_set fdset;
-            FD_ZERO(&fdset);
-            FD_SET(sock, &fdset);
+    if (patch.flags & TLM_CONFIG_COMMIT) {
+        if (s_cfg_err == ESP_OK) {
+            s_cfg_err = Config_Update(&s_cfg_staged, (patch.flags & TLM_CONFIG_PERSIST) != 0, health_id);
+        }
+        if (s_cfg_err != ESP_OK) {
+            ESP_LOGW(TAG, "Config update from ground station failed: %s", esp_err_to_name(s_cfg_err));
+        }
+        ack.err = s_cfg_err;
+        ack.version = Config_Get()->version;
+        Tcp_Conn_Send_Frame(conn, TLM_TYPE_CONFIG_ACK, &ack, sizeof(ack));
+        s_cfg_staging = 0;
+    }
+}
 
-            // Connection in progress -> have to wait until the connecting socket is marked as writable, i.e. connection completes
-            res = select(sock+1, NULL, &fdset, NULL, NULL);
-            if (res < 0) {
-                log_socket_error(TAG, sock, errno, "Error during connection: select for socket to be writable");
-                goto error;
-            } else if (res == 0) {
-                log_socket_error(TAG, sock, errno, "Connection timeout: select for socket to be writable");
-                goto error;
-            } else {
-                int sockerr;
-                socklen_t len = (socklen_t)sizeof(int);
-
-                if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (void*)(&sockerr), &len) < 0) {
-                    log_socket_error(TAG, sock, errno, "Error when getting socket error using getsockopt()");
-                    goto error;
-                }
-                if (sockerr) {
-                    log_socket_error(TAG, sock, sockerr, "Connection error");
-                    goto error;
-                }
+/**
+ * @brief Reads from the socket and handles every complete frame from the ground station
+ *
+ * Echo frames give the round trip time of the frame they echo, measured on this clock only.
+ * Config frames update the configuration.
+ *
+ * @param[in] conn Connection
+ * @param[in] health_id Calling task's Health_Register id
+ * @return
+ *          >=0 : Bytes read
+ *          <0 : Error or disconnect, the caller should close the connection
+ */
+static int tcp_handle_rx(tcp_conn_t *conn, int8_t health_id)
+{
+    const tlm_header_t *header;
+    tlm_echo_t echo;
+    uint16_t off = 0;
+    int64_t now;
+    int len;
+
+    len = Tcp_Conn_Recv(conn, &conn->rx_buf[conn->rx_len], TCP_RX_BUF_LEN - conn->rx_len, 0);
+    if (len <= 0) {
+        return len;
+    }
+    now = esp_timer_get_time();
+    conn->rx_len += len;
+
+    while (conn->rx_len >= off + sizeof(tlm_header_t)) {
+        header = (const tlm_header_t *)&conn->rx_buf[off];
+        if (header->magic != TLM_MAGIC || header->version != TLM_VERSION
+            || sizeof(tlm_header_t) + header->length > TCP_RX_BUF_LEN) {
+            ESP_LOGE(TAG, "[sock=%d]: Bad frame from ground station", conn->sock);
+            return -1;
+        }
+        if (conn->rx_len < off + sizeof(tlm_header_t) + header->length) {
+            break;
+        }
+
+        if (header->type == TLM_TYPE_ECHO && header->length == sizeof(tlm_echo_t)) {
+            memcpy(&echo, &conn->rx_buf[off + sizeof(tlm_header_t)], sizeof(echo));
+            conn->rtt_last_us = now - echo.vehicle_tx_us;
+            if (conn->rtt_last_us > conn->rtt_max_us) {
+                conn->rtt_max_us = conn->rtt_last_us;
             }
-        } else {
-            log_socket_error(TAG, sock, errno, "Socket is unable to connect");
-            goto error;
+            conn->echoes++;
+        } else if (header->type == TLM_TYPE_CONFIG) {
+            tcp_handle_config(conn, &conn->rx_buf[off + sizeof(tlm_header_t)], header->length, health_id);
         }
+        off += sizeof(tlm_header_t) + header->length;
     }
 
-    ESP_LOGI(TAG, "Client sends data to the server...");
-    int len = socket_send(TAG, sock, payload, strlen(payload));
-    if (len < 0) {
-        ESP_LOGE(TAG, "Error occurred during socket_send");
-        goto error;
+    memmove(conn->rx_buf, &conn->rx_buf[off], conn->rx_len - off);
+    conn->rx_len -= off;
+    return len;
+}
+
+/**
+ * @brief Wakes the client task at the start of its slot
+ */
+static void tcp_slot_timer_cb(void *args)
+{
+    if (s_client_task) {
+        xTaskNotifyGive(s_client_task);
     }
-    ESP_LOGI(TAG, "Written: %.*s", len, payload);
+}
 
-    // Keep receiving until we have a reply
-    do {
-        len = try_receive(TAG, sock, rx_buffer, sizeof(rx_buffer));
-        if (len < 0) {
-            ESP_LOGE(TAG, "Error occurred during try_receive");
-            goto error;
-        }
-        vTaskDelay(pdMS_TO_TICKS(YIELD_TO_ALL_MS));
-    } while (len == 0);
-    ESP_LOGI(TAG, "Received: %.*s", len, rx_buffer);
+/**
+ * @brief Returns microseconds until this unit's next transmit slot starts
+ *
+ * Slots are aligned to GPS time, so every unit agrees on them without talking to
+ * the others. Returns 0, i.e. send now, when slotting is off or there is no PPS time.
+ * NMEA time alone is only good to about 10 ms and arrives late, too coarse for ms slots.
+ *
+ * @param[in] cfg Active configuration
+ */
+static int64_t tcp_slot_wait_us(const laelaps_config_t *cfg)
+{
+    int64_t frame_us = (int64_t)cfg->fleet_frame_ms * 1000;
+    int64_t slot_start_us;
+    int64_t utc_us;
+    int64_t wait_us;
 
-error:
-    if (sock != INVALID_SOCK) {
-        close(sock);
+    if (cfg->fleet_num_slots < 2) {
+        return 0;
+    }
+    if (Time_Sync_Quality() != TIME_SYNC_PPS) {
+        return 0;
+    }
+    utc_us = Time_Now_UTC();
+    if (utc_us < 0) {
+        return 0;
     }
-    free(address_info);
-    vTaskDelete(NULL);
 
+    slot_start_us = cfg->fleet_slot * (frame_us / cfg->fleet_num_slots);
+    wait_us = (slot_start_us - utc_us % frame_us + frame_us) % frame_us;
+    return wait_us ? wait_us : frame_us;
 }
-#endif // CONFIG_EXAMPLE_TCP_CLIENT
 
-void app_main(void)
+/**
+ * @brief Task that owns the telemetry socket
+ *
+ * Connects (and reconnects) to the configured ground station, flushes the TX
+ * queue whenever it has data and handles what the ground station sends.
+ * In fleet mode the queue is flushed once per slot instead.
+ */
+void Tcp_Client_Task(void *args)
 {
-    ESP_ERROR_CHECK(nvs_flash_init());
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    const laelaps_config_t *cfg;
+    int8_t health_id = Health_Register(TCP_HEALTH_PERIOD_MS);
+    uint32_t flush_timeout_ms;
+    int64_t slot_us;
+    int64_t left_us;
+    int64_t wait_us;
+    int sock;
+
+    s_client_task = xTaskGetCurrentTaskHandle();
+    s_tlm_conn.notify_task = s_client_task;
+    Memory_Task_Ready();
+
+    while (1) {
+        Health_Beat(health_id);
+        cfg = Config_Get();
+
+        if (s_tlm_conn.sock == INVALID_SOCK) {
+            sock = tcp_connect(TAG, cfg->tlm_host, cfg->tlm_port, health_id);
+            if (sock == INVALID_SOCK) {
+                vTaskDelay(pdMS_TO_TICKS(TCP_RECONNECT_MS));
+                continue;
+            }
+            Tcp_Conn_Attach(&s_tlm_conn, sock);
+        }
+        // Connecting blocks, the copy from the top of the loop may be replaced by now
+        cfg = Config_Get();
 
-    /* This helper function configures Wi-Fi or Ethernet, as selected in menuconfig.
-     * Read "Establishing Wi-Fi or Ethernet Connection" section in
-     * examples/protocols/README.md for more information about this function.
-     */
-    ESP_ERROR_CHECK(example_connect());
+        // Tick resolution is too coarse for slots, wait on an esp_timer instead
+        flush_timeout_ms = TCP_FLUSH_TIMEOUT_MS;
+        wait_us = tcp_slot_wait_us(cfg);
+        if (wait_us > 0) {
+            esp_timer_stop(s_slot_timer);   // Still armed if the last wait timed out
+            ESP_ERROR_CHECK(esp_timer_start_once(s_slot_timer, wait_us));
+            // Producers notify too, only the slot start ends the wait
+            slot_us = esp_timer_get_time() + wait_us;
+            while ((left_us = slot_us - esp_timer_get_time()) > 0) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(left_us / 1000) + 1);
+            }
+            flush_timeout_ms = 0;   // Never spill into the next unit's slot
+        }
 
-    xTaskCreate(tcp_client_task, "tcp_client", 4096, NULL, 5, NULL);
+        if (Tcp_Conn_Flush(&s_tlm_conn, flush_timeout_ms) < 0) {
+            Tcp_Conn_Close(&s_tlm_conn);
+            continue;
+        }
+
+        if (tcp_handle_rx(&s_tlm_conn, health_id) < 0) {
+            Tcp_Conn_Close(&s_tlm_conn);
+            continue;
+        }
+
+        // Batching lets frames pile up so the radio wakes once per batch, slots already batch
+        // The flush blocks and a config frame may just have replaced cfg
+        cfg = Config_Get();
+        if (wait_us == 0 && cfg->tlm_batch_ms) {
+            vTaskDelay(pdMS_TO_TICKS(cfg->tlm_batch_ms));
+        }
+        // Nothing left to send, sleep until a producer queues more. The timeout
+        // keeps frames from the ground station handled while nothing is sent
+        else if (wait_us == 0 && s_tlm_conn.used == 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TCP_FLUSH_TIMEOUT_MS));
+        }
+    }
 }
@@ -0,0 +1,92 @@
+/*
+This file holds the macro definitions and types for tcp_client.c and tcp_conn.c
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef TCP_CLIENT_H
+#define TCP_CLIENT_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+// Defaults, used when no configuration is stored in NVS
+#define TCP_SERVER_HOST         "192.168.4.1"
+#define TCP_SERVER_PORT         5760
+#define TCP_UNIT_ID             0               // 0 derives the unit ID from the eFuse MAC
+#define TCP_FLEET_NUM_SLOTS     0               // 0 or 1 sends whenever there is data
+#define TCP_FLEET_SLOT          0
+#define TCP_FLEET_FRAME_MS      20              // One slot per vehicle every frame, 50 Hz
+#define TCP_FLEET_FRAME_MAX_MS  1000            // Must also divide a day, so slots line up across midnight
+// Slots follow PPS time. Without PPS lock units send whenever there is data
+
+#define TCP_TX_QUEUE_LEN        4096            // Bytes of queued frames per connection
+#define TCP_CONNECT_TIMEOUT_MS  3000
+#define TCP_CONNECT_SLICE_MS    500             // The connecting task beats between slices, below 1000
+// A name lookup blocks in lwIP without beats. It gives up on a DNS server
+// after 4 tries, 1 + 1 + 2 + 3 s, the AP hands out one server
+#define TCP_RESOLVE_MAX_MS      7000
+#define TCP_FLUSH_TIMEOUT_MS    20              // Longest the client task waits for the socket
+#define TCP_RECONNECT_MS        1000
+// Longest a task that owns a connection goes between beats, name lookups aside
+#define TCP_HEALTH_PERIOD_MS    (TCP_RECONNECT_MS + TCP_CONNECT_SLICE_MS)
+#define TCP_RX_BUF_LEN          256
+
+// File descriptor of a closed or not yet opened connection
+#define INVALID_SOCK            -1
+
+// Return codes, besides byte counts
+#define TCP_ERR                 -1
+#define TCP_ERR_BACKPRESSURE    -2              // TX queue cannot take the whole frame, nothing queued
+#define TCP_ERR_NOT_CONNECTED   -3
+
+
+// Custom data types
+// One segment of a frame, sent together with the others with no copy in between
+typedef struct Tcp_Vec{
+    const void *base;
+    uint16_t len;
+} tcp_vec_t;
+
+// One connection with a bounded TX queue
+// Producers append whole frames under lock, the client task sends from the
+// tail without holding the lock, producers never touch bytes between tail and head
+typedef struct Tcp_Conn{
+    int sock;
+    SemaphoreHandle_t lock;
+    StaticSemaphore_t lock_buf;
+    uint8_t tx_buf[TCP_TX_QUEUE_LEN];
+    uint16_t head;                              // Next byte written by producers
+    uint16_t tail;                              // Next byte sent
+    uint16_t used;
+    uint16_t high_water;
+    uint16_t tx_seq;                            // seq of the next frame from Tcp_Conn_Send_Frame, under lock
+    uint16_t unit_id;                           // Stamped into frames by Tcp_Conn_Send_Frame
+    TaskHandle_t notify_task;                   // Notified when the queue stops being empty, NULL for none
+    uint32_t dropped_frames;
+    uint32_t sent_bytes;
+    uint8_t rx_buf[TCP_RX_BUF_LEN];             // Partial frame carried over between reads
+    uint16_t rx_len;
+    uint32_t echoes;                            // Echo frames received from the ground station
+    int64_t rtt_last_us;
+    int64_t rtt_max_us;
+} tcp_conn_t;
+
+
+// Function prototypes of tcp_conn.c, shared with the host tools so not in functions.h
+void Tcp_Log_Socket_Error(const char *tag, const int sock, const int err, const char *message);
+void Tcp_Conn_Init(tcp_conn_t *conn);
+void Tcp_Conn_Attach(tcp_conn_t *conn, int sock);
+int Tcp_Conn_Recv(tcp_conn_t *conn, void *buf, uint16_t max_len, uint32_t timeout_ms);
+void Tcp_Conn_Close(tcp_conn_t *conn);
+uint16_t Tcp_Conn_Tx_Free(const tcp_conn_t *conn);
+int Tcp_Conn_Send_Vec(tcp_conn_t *conn, const tcp_vec_t *vec, uint8_t count);
+int Tcp_Conn_Flush(tcp_conn_t *conn, uint32_t timeout_ms);
+int Tcp_Conn_Send_Frame(tcp_conn_t *conn, uint8_t type, const void *payload, uint16_t len);
+
+#endif
@@ -0,0 +1,357 @@
+/* Telemetry connection with a bounded TX queue
+
+   Split out of tcp_client.c so the host tools run the same queueing code
+   as the vehicle. Only uses sockets, one mutex, task notifications,
+   esp_timer_get_time and logging, which tools/ground_station/shim maps to
+   POSIX. Connecting and name lookup stay in tcp_client.c.
+*/
+#include <string.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sys/socket.h"
+#include "lwip/sockets.h"
+#include "errno.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "tcp_client.h"
+#include "telemetry.h"
+
+static const char *TAG = "tcp_conn";
+
+/**
+ * @brief Utility to log socket errors
+ *
+ * @param[in] tag Logging tag
+ * @param[in] sock Socket number
+ * @param[in] err Socket errno
+ * @param[in] message Message to print
+ */
+void Tcp_Log_Socket_Error(const char *tag, const int sock, const int err, const char *message)
+{
+    ESP_LOGE(tag, "[sock=%d]: %s\n"
+                  "error=%d: %s", sock, message, err, strerror(err));
+}
+
+/**
+ * @brief Tries to receive data from specified sockets in a non-blocking way,
+ *        i.e. returns immediately if no data.
+ *
+ * @param[in] tag Logging tag
+ * @param[in] sock Socket for reception
+ * @param[out] data Data pointer to write the received data
+ * @param[in] max_len Maximum size of the allocated space for receiving data
+ * @return
+ *          >0 : Size of received data
+ *          =0 : No data available
+ *          -1 : Error occurred during socket read operation
+ *          -2 : Socket is not connected, to distinguish between an actual socket error and active disconnection
+ */
+static int try_receive(const char *tag, const int sock, char * data, size_t max_len)
+{
+    int len = recv(sock, data, max_len, 0);
+    if (len < 0) {
+        if (errno == EINPROGRESS || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;   // Not an error
+        }
+        if (errno == ENOTCONN) {
+            ESP_LOGW(tag, "[sock=%d]: Connection closed", sock);
+            return -2;  // Socket has been disconnected
+        }
+        Tcp_Log_Socket_Error(tag, sock, errno, "Error occurred during receiving");
+        return -1;
+    }
+    if (len == 0) {
+        ESP_LOGW(tag, "[sock=%d]: Connection closed by peer", sock);
+        return -2;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Prepares a connection for use. Must be called once before anything else
+ *
+ * @param[in] conn Connection
+ */
+void Tcp_Conn_Init(tcp_conn_t *conn)
+{
+    memset(conn, 0, sizeof(tcp_conn_t));
+    conn->sock = INVALID_SOCK;
+    conn->lock = xSemaphoreCreateMutexStatic(&conn->lock_buf);
+}
+
+/**
+ * @brief Attaches a connected socket and empties the TX queue
+ *
+ * @param[in] conn Connection
+ * @param[in] sock Connected non-blocking socket
+ */
+void Tcp_Conn_Attach(tcp_conn_t *conn, int sock)
+{
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    conn->sock = sock;
+    conn->head = 0;
+    conn->tail = 0;
+    conn->used = 0;
+    conn->rx_len = 0;
+    xSemaphoreGive(conn->lock);
+}
+
+/**
+ * @brief Reads whatever the socket has, waiting up to timeout_ms for it
+ *
+ * For connections whose owner parses the stream itself, rx_buf is not used.
+ *
+ * @param[in] conn Connection
+ * @param[out] buf Received bytes
+ * @param[in] max_len Size of buf
+ * @param[in] timeout_ms Longest time to wait for data
+ * @return
+ *          >0 : Bytes read
+ *          =0 : Nothing arrived in time
+ *          <0 : Error or disconnect, the caller should close the connection
+ */
+int Tcp_Conn_Recv(tcp_conn_t *conn, void *buf, uint16_t max_len, uint32_t timeout_ms)
+{
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    fd_set fdset;
+    int res;
+
+    if (conn->sock == INVALID_SOCK) {
+        return TCP_ERR_NOT_CONNECTED;
+    }
+    FD_ZERO(&fdset);
+    FD_SET(conn->sock, &fdset);
+    res = select(conn->sock + 1, &fdset, NULL, NULL, &timeout);
+    if (res < 0) {
+        Tcp_Log_Socket_Error(TAG, conn->sock, errno, "Error during select for socket to be readable");
+        return TCP_ERR;
+    }
+    if (res == 0) {
+        return 0;
+    }
+    return try_receive(TAG, conn->sock, buf, max_len);
+}
+
+/**
+ * @brief Closes the socket and drops everything queued
+ *
+ * @param[in] conn Connection
+ */
+void Tcp_Conn_Close(tcp_conn_t *conn)
+{
+    int sock;
+
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    sock = conn->sock;
+    conn->sock = INVALID_SOCK;
+    conn->head = 0;
+    conn->tail = 0;
+    conn->used = 0;
+    xSemaphoreGive(conn->lock);
+
+    if (sock != INVALID_SOCK) {
+        close(sock);
+    }
+}
+
+/**
+ * @brief Returns how many bytes the TX queue can take right now
+ *
+ * Producers can use this to decimate before building a frame.
+ * Not locked, the value is only a hint.
+ */
+uint16_t Tcp_Conn_Tx_Free(const tcp_conn_t *conn)
+{
+    return TCP_TX_QUEUE_LEN - conn->used;
+}
+
+/**
+ * @brief Queues one frame made of several segments, see Tcp_Conn_Send_Vec
+ *
+ * @param[in] conn Connection
+ * @param[in] vec Segments, sent back to back in order
+ * @param[in] count Number of segments
+ * @param[in,out] header Frame header among the segments to get the next seq, or NULL.
+ *                       Stamped under the lock so producers on other tasks queue in seq order
+ * @return Same as Tcp_Conn_Send_Vec
+ */
+static int tcp_conn_send(tcp_conn_t *conn, const tcp_vec_t *vec, uint8_t count, tlm_header_t *header)
+{
+    uint32_t total = 0;
+    uint16_t first;
+    uint8_t was_empty;
+    uint8_t i;
+    int ret;
+
+    for (i = 0; i < count; i++) {
+        total += vec[i].len;
+    }
+
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    // Dropped frames use up their seq too, the ground station counts them as gaps
+    if (header) {
+        header->seq = conn->tx_seq++;
+    }
+    was_empty = (conn->used == 0);
+    if (conn->sock == INVALID_SOCK) {
+        ret = TCP_ERR_NOT_CONNECTED;
+    } else if (total > (uint32_t)(TCP_TX_QUEUE_LEN - conn->used)) {
+        ret = TCP_ERR_BACKPRESSURE;
+    } else {
+        for (i = 0; i < count; i++) {
+            // Copy in up to two pieces around the end of the ring
+            first = TCP_TX_QUEUE_LEN - conn->head;
+            if (first > vec[i].len) {
+                first = vec[i].len;
+            }
+            memcpy(&conn->tx_buf[conn->head], vec[i].base, first);
+            memcpy(&conn->tx_buf[0], (const uint8_t *)vec[i].base + first, vec[i].len - first);
+            conn->head = (conn->head + vec[i].len) % TCP_TX_QUEUE_LEN;
+        }
+        conn->used += total;
+        if (conn->used > conn->high_water) {
+            conn->high_water = conn->used;
+        }
+        ret = total;
+    }
+    if (ret < 0) {
+        conn->dropped_frames++;
+    }
+    xSemaphoreGive(conn->lock);
+
+    if (ret > 0 && was_empty && conn->notify_task) {
+        xTaskNotifyGive(conn->notify_task);
+    }
+    return ret;
+}
+
+/**
+ * @brief Queues one frame made of several segments. Never waits for the network
+ *
+ * The frame is queued whole or not at all, so the stream never carries a partial frame.
+ * The first frame into an empty queue wakes the connection's notify_task.
+ *
+ * @param[in] conn Connection
+ * @param[in] vec Segments, sent back to back in order
+ * @param[in] count Number of segments
+ * @return
+ *          >0 : Bytes queued
+ *          TCP_ERR_BACKPRESSURE : Not enough room, nothing queued
+ *          TCP_ERR_NOT_CONNECTED : No socket, nothing queued
+ */
+int Tcp_Conn_Send_Vec(tcp_conn_t *conn, const tcp_vec_t *vec, uint8_t count)
+{
+    return tcp_conn_send(conn, vec, count, NULL);
+}
+
+/**
+ * @brief Sends as much of the TX queue as the socket takes without blocking
+ *
+ * Waits up to timeout_ms for the socket to become writable. Handles short writes
+ * and EAGAIN by leaving the rest queued for the next call.
+ *
+ * @param[in] conn Connection
+ * @param[in] timeout_ms Longest time to wait for the socket
+ * @return
+ *          >=0 : Bytes sent
+ *          -1 : Error occurred, the caller should close the connection
+ */
+int Tcp_Conn_Flush(tcp_conn_t *conn, uint32_t timeout_ms)
+{
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    struct iovec iov[2];
+    int iovcnt = 1;
+    uint16_t tail;
+    uint16_t used;
+    fd_set fdset;
+    int sock;
+    int res;
+
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    sock = conn->sock;
+    tail = conn->tail;
+    used = conn->used;
+    xSemaphoreGive(conn->lock);
+
+    if (sock == INVALID_SOCK || used == 0) {
+        return 0;
+    }
+
+    FD_ZERO(&fdset);
+    FD_SET(sock, &fdset);
+    res = select(sock + 1, NULL, &fdset, NULL, &timeout);
+    if (res < 0) {
+        Tcp_Log_Socket_Error(TAG, sock, errno, "Error during select for socket to be writable");
+        return -1;
+    }
+    if (res == 0) {
+        return 0;   // Link stalled, keep the data queued
+    }
+
+    // Bytes between tail and tail + used are never touched by producers
+    iov[0].iov_base = &conn->tx_buf[tail];
+    iov[0].iov_len = used;
+    if (tail + used > TCP_TX_QUEUE_LEN) {
+        iov[0].iov_len = TCP_TX_QUEUE_LEN - tail;
+        iov[1].iov_base = &conn->tx_buf[0];
+        iov[1].iov_len = used - iov[0].iov_len;
+        iovcnt = 2;
+    }
+
+    res = lwip_writev(sock, iov, iovcnt);
+    if (res < 0) {
+        if (errno == EINPROGRESS || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        Tcp_Log_Socket_Error(TAG, sock, errno, "Error occurred during sending");
+        return -1;
+    }
+
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    conn->tail = (conn->tail + res) % TCP_TX_QUEUE_LEN;
+    conn->used -= res;
+    conn->sent_bytes += res;
+    xSemaphoreGive(conn->lock);
+
+    return res;
+}
+
+/**
+ * @brief Queues one telemetry frame on a connection
+ *
+ * Header and payload go into the queue as two segments, the payload is not staged.
+ * The sequence number advances even if the frame is not queued, so the receiver
+ * sees drops as gaps.
+ *
+ * @param[in] conn Connection
+ * @param[in] type TLM_TYPE_ frame type
+ * @param[in] payload Frame payload
+ * @param[in] len Payload length
+ * @return Same as Tcp_Conn_Send_Vec
+ */
+int Tcp_Conn_Send_Frame(tcp_conn_t *conn, uint8_t type, const void *payload, uint16_t len)
+{
+    tlm_header_t header = {
+        .magic = TLM_MAGIC,
+        .version = TLM_VERSION,
+        .type = type,
+        .length = len,
+        .unit_id = conn->unit_id,
+        .tx_time_us = esp_timer_get_time(),
+    };
+    tcp_vec_t vec[2] = {
+        { .base = &header, .len = sizeof(header) },
+        { .base = payload, .len = len },
+    };
+
+    return tcp_conn_send(conn, vec, 2, &header);
+}
@@ -0,0 +1,130 @@
+/*
+This file holds the telemetry frame format shared by the firmware and
+the host side tools. Plain C, no ESP-IDF headers
+All fields are little endian, which both the ESP32 and x86 hosts are
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#define TLM_MAGIC           0x334C              // "L3"
+#define TLM_VERSION         2
+#define TLM_MAX_PAYLOAD     512
+#define TLM_NUM_SERVOS      8
+
+// Frame types
+// Vehicle to ground
+#define TLM_TYPE_STATE      0x01
+#define TLM_TYPE_REPLAY     0x02                // Control replay record, see control.h
+#define TLM_TYPE_OTA_QUERY  0x03                // Update connection only
+#define TLM_TYPE_OTA_REQ    0x04
+#define TLM_TYPE_CONFIG_ACK 0x05                // Reply to the last frame of a config update
+// Ground to vehicle
+#define TLM_TYPE_ECHO       0x81
+#define TLM_TYPE_OTA_INFO   0x82                // Update connection only
+#define TLM_TYPE_OTA_DATA   0x83
+#define TLM_TYPE_CONFIG     0x84                // Telemetry connection only
+
+// Firmware update
+// The vehicle sends a query with the hash of its running image, the server
+// answers with the image it has. The vehicle then requests blocks of the
+// image, each block comes back as one or more data frames
+// Blocks are one flash sector. Each is encoded on its own so a transfer
+// can resume at any block
+#define TLM_OTA_HASH_LEN    32                  // SHA-256 esptool appends to the image
+#define TLM_OTA_BLOCK_LEN   4096
+#define TLM_OTA_ENC_RAW     0
+#define TLM_OTA_ENC_DEFLATE 1                   // zlib stream of the block
+#define TLM_OTA_ENC_COPY    2                   // Same bytes as the running image at src, no data
+
+// Configuration update
+// The ground station patches byte ranges of laelaps_config_t (main/config.h)
+// The first frame of an update starts from the vehicle's active configuration,
+// the last one validates and publishes it, and is answered with an ack
+#define TLM_CONFIG_BEGIN    0x01
+#define TLM_CONFIG_COMMIT   0x02
+#define TLM_CONFIG_PERSIST  0x04                // With COMMIT, also store it in NVS
+#define TLM_CONFIG_PIECE_MAX    200             // Keeps a frame within the vehicle's receive buffer
+
+
+// Custom data types
+// Every frame starts with this header, followed by length bytes of payload
+typedef struct __attribute__((packed)) Tlm_Header{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t length;                            // Payload bytes, header not included
+    uint16_t seq;
+    uint16_t unit_id;                           // Vehicle the frame is from, or for
+    int64_t tx_time_us;                         // Sender's clock when the frame was queued
+} tlm_header_t;
+
+// TLM_TYPE_STATE payload, one per control loop iteration
+typedef struct __attribute__((packed)) Tlm_State{
+    float lat;
+    float lon;
+    float altitude;
+    uint8_t sats;
+    uint8_t failsafe;
+    int16_t servo[TLM_NUM_SERVOS];
+} tlm_state_t;
+
+// TLM_TYPE_ECHO payload, the ground station's reply to a frame
+typedef struct __attribute__((packed)) Tlm_Echo{
+    uint16_t seq;                               // seq of the frame being echoed
+    int64_t vehicle_tx_us;                      // tx_time_us of the frame being echoed
+    int64_t ground_rx_us;                       // Ground clock when it arrived
+    int64_t ground_tx_us;                       // Ground clock when the echo was sent
+} tlm_echo_t;
+
+// TLM_TYPE_OTA_QUERY payload
+typedef struct __attribute__((packed)) Tlm_Ota_Query{
+    uint8_t running_hash[TLM_OTA_HASH_LEN];
+    uint8_t encodings;                          // Bit per TLM_OTA_ENC_ the vehicle can decode
+} tlm_ota_query_t;
+
+// TLM_TYPE_OTA_INFO payload, image_len 0 if there is nothing newer
+typedef struct __attribute__((packed)) Tlm_Ota_Info{
+    uint32_t image_len;
+    uint8_t image_hash[TLM_OTA_HASH_LEN];       // Identifies the image, for resuming
+} tlm_ota_info_t;
+
+// TLM_TYPE_OTA_REQ payload
+typedef struct __attribute__((packed)) Tlm_Ota_Req{
+    uint32_t first_block;
+    uint16_t count;
+} tlm_ota_req_t;
+
+// TLM_TYPE_OTA_DATA payload, followed by the piece of the encoded block
+typedef struct __attribute__((packed)) Tlm_Ota_Data{
+    uint32_t block;
+    uint8_t encoding;
+    uint16_t enc_len;                           // Encoded block length, 0 for COPY
+    uint16_t offset;                            // Of this piece in the encoded block
+    uint32_t src;                               // Running image offset for COPY
+} tlm_ota_data_t;
+
+#define TLM_OTA_PIECE_MAX   (TLM_MAX_PAYLOAD - sizeof(tlm_ota_data_t))
+
+// TLM_TYPE_CONFIG payload, followed by the bytes to write at offset
+typedef struct __attribute__((packed)) Tlm_Config{
+    uint32_t schema_version;                    // CFG_SCHEMA_VERSION the patch was made for
+    uint16_t offset;
+    uint8_t flags;                              // TLM_CONFIG_
+} tlm_config_t;
+
+// TLM_TYPE_CONFIG_ACK payload
+typedef struct __attribute__((packed)) Tlm_Config_Ack{
+    int32_t err;                                // esp_err_t, 0 if the update is active
+    uint32_t version;                           // Config version active after the update
+} tlm_config_ack_t;
+
+#endif
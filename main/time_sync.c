@@ -0,0 +1,192 @@
+/*
+This file holds the source code for the GPS time service
+Every NMEA sentence is timestamped with esp_timer on arrival. If a PPS
+input is configured its edges are captured in an ISR and used as the
+anchor instead, since the edge marks the start of the UTC second exactly
+Consecutive anchors are used to estimate the drift of the local clock
+so local time can be converted to UTC between sentences
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "time_sync.h"
+#include "config.h"
+#include "functions.h"
+
+
+// Global to this file
+// Shared with the PPS ISR. USE SPINLOCK
+static portMUX_TYPE time_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static time_sync_state_t time_state = {0};
+static int64_t time_pps_local_us = 0;
+
+// Only used by Time_Sync_On_Sentence
+static int64_t time_pps_used_us = 0;
+static const char* TIME_TAG = "Time_Sync";
+
+
+// Time_Wrap_Day
+// Brings a difference of UTC times of day into half a day either side of 0
+// Anchors either side of midnight are a few seconds apart, not almost a day
+static int64_t Time_Wrap_Day(int64_t delta_us){
+    if(delta_us >= TIME_US_PER_DAY / 2) return delta_us - TIME_US_PER_DAY;
+    if(delta_us < -TIME_US_PER_DAY / 2) return delta_us + TIME_US_PER_DAY;
+    return delta_us;
+}
+
+
+// Time_PPS_ISR
+// Captures the local time of a PPS rising edge
+static void IRAM_ATTR Time_PPS_ISR(void *args){
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&time_spinlock);
+    time_pps_local_us = now;
+    portEXIT_CRITICAL_ISR(&time_spinlock);
+}
+
+
+// Init_Time_Sync
+// Sets up the PPS input if one is configured
+void Init_Time_Sync(void){
+    int8_t pin = Config_Get()->gps_pps_pin;
+    esp_err_t err;
+
+    if(pin < 0){
+        ESP_LOGI(TIME_TAG, "No PPS input, using NMEA arrival time");
+        return;
+    }
+
+    gpio_config_t pps_config = {
+        .pin_bit_mask = 1ULL << pin,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = 0,
+        .pull_down_en = 0,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&pps_config));
+
+    // ISR service may already be installed by another module
+    err = gpio_install_isr_service(0);
+    if(err != ESP_ERR_INVALID_STATE) ESP_ERROR_CHECK(err);
+    ESP_ERROR_CHECK(gpio_isr_handler_add(pin, Time_PPS_ISR, NULL));
+
+    ESP_LOGI(TIME_TAG, "PPS on GPIO %d", pin);
+}
+
+
+// Time_Sync_On_Sentence
+// Updates the local to UTC mapping from one timestamped sentence
+// Takes UTC milliseconds of day from the sentence, esp_timer time the
+// sentence finished arriving, and the sentence length in bytes
+void Time_Sync_On_Sentence(uint32_t utc_ms_of_day, int64_t rx_us, uint16_t line_len){
+    time_sync_state_t prev;
+    time_sync_state_t next;
+    int64_t pps_us;
+    // A leap second reads 23:59:60, past the end of the day
+    int64_t utc_us = ((int64_t) utc_ms_of_day * 1000) % TIME_US_PER_DAY;
+    int64_t local_delta;
+    int64_t utc_delta;
+    int64_t measured_ppb;
+
+    portENTER_CRITICAL(&time_spinlock);
+    pps_us = time_pps_local_us;
+    prev = time_state;
+    portEXIT_CRITICAL(&time_spinlock);
+
+    if((pps_us != 0) && (pps_us != time_pps_used_us) && (rx_us - pps_us < TIME_PPS_MATCH_US)){
+        // Fresh PPS edge, it marks the start of this sentence's UTC second
+        next.anchor_local_us = pps_us;
+        next.anchor_utc_us = (utc_us / 1000000) * 1000000;
+        next.quality = TIME_SYNC_PPS;
+        time_pps_used_us = pps_us;
+    }
+    else if((pps_us != 0) && (rx_us - pps_us < TIME_PPS_TIMEOUT_US)){
+        // PPS is alive but this edge was already used, NMEA would only add jitter
+        return;
+    }
+    else{
+        // No PPS, back out the time spent shifting the sentence in
+        next.anchor_local_us = rx_us - TIME_NMEA_DELAY_US - ((int64_t) line_len * 10 * 1000000) / Config_Get()->gps_baud;
+        next.anchor_utc_us = utc_us;
+        next.quality = TIME_SYNC_NMEA;
+    }
+
+    // Update drift estimate from anchors of the same quality
+    next.drift_ppb = prev.drift_ppb;
+    if(prev.quality == next.quality){
+        local_delta = next.anchor_local_us - prev.anchor_local_us;
+        utc_delta = Time_Wrap_Day(next.anchor_utc_us - prev.anchor_utc_us);
+
+        if((utc_delta >= TIME_DRIFT_MIN_US) && (utc_delta <= TIME_DRIFT_MAX_US)){
+            measured_ppb = (local_delta - utc_delta) * 1000000000LL / utc_delta;
+            // A crystal is within a few hundred ppm, anything else is a mismatched anchor
+            if((measured_ppb > -500000) && (measured_ppb < 500000)){
+                next.drift_ppb += (int32_t) ((measured_ppb - next.drift_ppb) >> TIME_DRIFT_FILTER_SHIFT);
+            }
+        }
+    }
+
+    portENTER_CRITICAL(&time_spinlock);
+    time_state = next;
+    portEXIT_CRITICAL(&time_spinlock);
+}
+
+
+// Get_Time_Sync_State
+// Copies the current local to UTC mapping
+void Get_Time_Sync_State(time_sync_state_t *out){
+    portENTER_CRITICAL(&time_spinlock);
+    *out = time_state;
+    portEXIT_CRITICAL(&time_spinlock);
+}
+
+
+// Time_Local_To_UTC
+// Converts an esp_timer timestamp to UTC microseconds of day
+// Returns -1 if no sentence has been received yet
+int64_t Time_Local_To_UTC(int64_t local_us){
+    time_sync_state_t state;
+    int64_t delta;
+    int64_t utc_us;
+
+    Get_Time_Sync_State(&state);
+    if(state.quality == TIME_SYNC_NONE) return -1;
+
+    delta = local_us - state.anchor_local_us;
+    utc_us = state.anchor_utc_us + delta - (delta * state.drift_ppb) / 1000000000LL;
+    utc_us %= TIME_US_PER_DAY;
+    if(utc_us < 0) utc_us += TIME_US_PER_DAY;
+    return utc_us;
+}
+
+
+// Time_Now_UTC
+// Returns the current UTC microseconds of day, -1 if not synced
+int64_t Time_Now_UTC(void){
+    return Time_Local_To_UTC(esp_timer_get_time());
+}
+
+
+// Time_Sync_Quality
+// Returns TIME_SYNC_ quality of the current mapping
+// A PPS mapping that has not been refreshed recently is reported as NMEA
+uint8_t Time_Sync_Quality(void){
+    time_sync_state_t state;
+    Get_Time_Sync_State(&state);
+    if((state.quality == TIME_SYNC_PPS) && (esp_timer_get_time() - state.anchor_local_us > TIME_PPS_TIMEOUT_US)){
+        return TIME_SYNC_NMEA;
+    }
+    return state.quality;
+}
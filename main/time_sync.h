@@ -0,0 +1,49 @@
+/*
+This file holds the macro definitions and types for time_sync.c
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+// Default PPS input, used when no configuration is stored in NVS
+// -1 disables PPS, time is then derived from NMEA arrival alone, too coarse for telemetry slots
+#define TIME_PPS_PIN            -1
+
+// A PPS edge is matched to the next sentence if it arrived less than this before it
+#define TIME_PPS_MATCH_US       900000
+// PPS is considered lost if no edge was seen for this long
+#define TIME_PPS_TIMEOUT_US     2500000
+// Receiver specific delay from the fix epoch to the first byte of the sentence
+#define TIME_NMEA_DELAY_US      0
+// Drift is only measured over anchors this far apart
+#define TIME_DRIFT_MIN_US       500000
+#define TIME_DRIFT_MAX_US       60000000
+// Drift filter gain is 1 / 2^TIME_DRIFT_FILTER_SHIFT
+#define TIME_DRIFT_FILTER_SHIFT 3
+
+#define TIME_US_PER_DAY         86400000000LL
+
+// Sync quality
+// NMEA arrival alone is coarse, about 10 ms and late by the receiver's output delay
+#define TIME_SYNC_NONE          0
+#define TIME_SYNC_NMEA          1
+#define TIME_SYNC_PPS           2
+
+
+// Custom data types
+// Mapping from esp_timer microseconds to UTC microseconds of day
+// utc = anchor_utc_us + (local - anchor_local_us) * (1 - drift_ppb / 1e9), wrapped to the day
+typedef struct Time_Sync_State{
+    int64_t anchor_local_us;
+    int64_t anchor_utc_us;
+    int32_t drift_ppb;
+    uint8_t quality;
+} time_sync_state_t;
+
+#endif
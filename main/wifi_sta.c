@@ -18,17 +18,19 @@ Last Built With ESP-IDF v5.2.2
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
 
-#define ESP_WIFI_SSID      "laelaps-tcp"
-#define ESP_WIFI_PASS      ""
-#define ESP_MAXIMUM_RETRY  5
+#include "wifi_sta.h"
+#include "config.h"
+#include "functions.h"
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
+static StaticEventGroup_t s_wifi_event_group_buf;
 
 /* The event group allows multiple bits for each event, but we only care about two events:
  * - we are connected to the AP with an IP
@@ -39,7 +41,20 @@ static EventGroupHandle_t s_wifi_event_group;
 static const char *TAG = "wifi station";
 
 static int s_retry_num = 0;
+static uint32_t s_backoff_ms = WIFI_BACKOFF_MIN_MS;
+static esp_timer_handle_t s_retry_timer = NULL;
 
+/* Link state for the failsafe. Written by the event handler, read by the control loop */
+static portMUX_TYPE s_link_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_link_up = false;
+static int64_t s_link_lost_us = 0;
+
+
+/* Retries the connection once the backoff is over. esp_timer callback, the event handler must not wait */
+static void retry_timer_cb(void *args)
+{
+    esp_wifi_connect();
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
@@ -47,24 +62,47 @@ static void event_handler(void* arg, esp_event_base_t event_base,
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < ESP_MAXIMUM_RETRY) {
+        portENTER_CRITICAL(&s_link_spinlock);
+        if (s_link_up) {
+            s_link_up = false;
+            s_link_lost_us = esp_timer_get_time();
+        }
+        portEXIT_CRITICAL(&s_link_spinlock);
+        if (s_retry_num < Config_Get()->wifi_max_retry) {
             esp_wifi_connect();
             s_retry_num++;
             ESP_LOGI(TAG, "retry to connect to the AP");
         } else {
+            /* Never give up for good, the failsafe would latch. Back off instead */
             xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            ESP_LOGI(TAG, "retry to connect to the AP in %lu ms", (unsigned long) s_backoff_ms);
+            esp_timer_start_once(s_retry_timer, (uint64_t) s_backoff_ms * 1000);
+            s_backoff_ms *= 2;
+            if (s_backoff_ms > WIFI_BACKOFF_MAX_MS) {
+                s_backoff_ms = WIFI_BACKOFF_MAX_MS;
+            }
         }
         ESP_LOGI(TAG,"connect to the AP fail");
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
         s_retry_num = 0;
+        s_backoff_ms = WIFI_BACKOFF_MIN_MS;
+        portENTER_CRITICAL(&s_link_spinlock);
+        s_link_up = true;
+        portEXIT_CRITICAL(&s_link_spinlock);
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
 void Init_Wifi_Sta(void){
-    s_wifi_event_group = xEventGroupCreate();
+    s_wifi_event_group = xEventGroupCreateStatic(&s_wifi_event_group_buf);
+
+    esp_timer_create_args_t retry_timer_args = {
+        .callback = retry_timer_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &s_retry_timer));
 
     ESP_ERROR_CHECK(esp_netif_init());
 
@@ -87,18 +125,22 @@ void Init_Wifi_Sta(void){
                                                         NULL,
                                                         &instance_got_ip));
 
+    const laelaps_config_t *laelaps_cfg = Config_Get();
     wifi_config_t wifi_config = {
         .sta = {
-            .ssid = ESP_WIFI_SSID,
-            .password = ESP_WIFI_PASS,
             .threshold.authmode = WIFI_AUTH_OPEN,
             .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
             .sae_h2e_identifier = "",
         },
     };
+    strncpy((char *) wifi_config.sta.ssid, laelaps_cfg->wifi_ssid, sizeof(wifi_config.sta.ssid));
+    strncpy((char *) wifi_config.sta.password, laelaps_cfg->wifi_pass, sizeof(wifi_config.sta.password));
+    // Wake for beacons about as often as telemetry is flushed
+    wifi_config.sta.listen_interval = Power_Listen_Interval(laelaps_cfg);
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
+    ESP_ERROR_CHECK(esp_wifi_set_ps((wifi_ps_type_t) laelaps_cfg->wifi_ps) );
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
@@ -114,11 +156,29 @@ void Init_Wifi_Sta(void){
      * happened. */
     if (bits & WIFI_CONNECTED_BIT) {
         ESP_LOGI(TAG, "connected to ap SSID:%s password:%s",
-                 ESP_WIFI_SSID, ESP_WIFI_PASS);
+                 wifi_config.sta.ssid, wifi_config.sta.password);
     } else if (bits & WIFI_FAIL_BIT) {
         ESP_LOGI(TAG, "Failed to connect to SSID:%s, password:%s",
-                 ESP_WIFI_SSID, ESP_WIFI_PASS);
+                 wifi_config.sta.ssid, wifi_config.sta.password);
     } else {
         ESP_LOGE(TAG, "UNEXPECTED EVENT");
     }
-}
\ No newline at end of file
+}
+
+/* Returns how long the station has been without an IP in microseconds, 0 while connected.
+ * Before the first connection the link counts as down since boot. */
+int64_t Wifi_Link_Down_us(void)
+{
+    bool link_up;
+    int64_t lost_us;
+
+    portENTER_CRITICAL(&s_link_spinlock);
+    link_up = s_link_up;
+    lost_us = s_link_lost_us;
+    portEXIT_CRITICAL(&s_link_spinlock);
+
+    if (link_up) {
+        return 0;
+    }
+    return esp_timer_get_time() - lost_us;
+}
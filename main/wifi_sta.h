@@ -0,0 +1,24 @@
+/*
+This file holds the macro definitions for wifi_sta.c
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+Last Built With ESP-IDF v5.2.2
+*/
+
+#ifndef WIFI_STA_H
+#define WIFI_STA_H
+
+// Defaults, used when no configuration is stored in NVS
+#define ESP_WIFI_SSID      "laelaps-tcp"
+#define ESP_WIFI_PASS      ""
+#define ESP_MAXIMUM_RETRY  5
+
+// After the quick retries the station keeps trying, backing off from the
+// minimum to the maximum wait. The link lost failsafe only clears once it is back
+#define WIFI_BACKOFF_MIN_MS 1000
+#define WIFI_BACKOFF_MAX_MS 30000
+
+#endif
@@ -0,0 +1,762 @@
+/*
+Host side stand-in for the ground station, plus a load generator that
+plays one or more vehicles. Used to benchmark the telemetry path
+(frame format, batching, TX queue sizes) over loopback without hardware
+
+serve  Fleet aggregator. Accepts vehicle connections and echoes frames
+       back with timestamps. Frames are accounted per unit ID, so stats
+       survive reconnects and two vehicles with the same ID are reported
+       Reports frames/s, bytes/s and sequence gaps (frames the vehicle
+       dropped under backpressure) once per second, per unit on exit
+       Single threaded, poll() based, so dozens of vehicles cost no threads
+       With -w the control replay frames of all vehicles are appended to a
+       file, as received, for tools/replay
+       With -c name=value the setting is sent to every vehicle as a config
+       update, until the vehicle acks it. -P also stores it in its NVS
+load   Opens one connection per vehicle, sends state frames at a fixed
+       rate and measures round trip and one way latency from the echoes
+       Frames go through the firmware's own TX queue, main/tcp_conn.c,
+       built against the FreeRTOS / esp_timer shim in shim/, so batching
+       and backpressure are those of the vehicle
+       With -S the vehicles are spread over the frame period like the
+       firmware's fleet slots, without it they all send at once
+       One way latency is only meaningful when both ends share a clock,
+       i.e. on the same host
+
+Frames are the ones in main/telemetry.h, timestamps are CLOCK_MONOTONIC us
+
+Build:  gcc -O2 -Wall -Itools/ground_station/shim -o ground_station tools/ground_station/ground_station.c \
+            main/tcp_conn.c -lpthread
+Usage:  ground_station serve [-p port] [-e echo_every] [-w replay_file]
+                             [-c name=value ...] [-P]
+        ground_station load [-a addr] [-p port] [-v vehicles] [-r rate_hz]
+                            [-b batch] [-s payload_bytes] [-t seconds]
+                            [-u first_unit_id] [-S]
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "../../main/telemetry.h"
+#include "../../main/config.h"
+#include "../../main/tcp_client.h"
+
+#define GS_DEFAULT_PORT     5760
+#define GS_MAX_CLIENTS      128
+#define GS_MAX_UNITS        256             // Power of 2, open addressed by unit ID
+#define GS_BUF_LEN          16384           // Per connection, each direction
+#define GS_REPORT_US        1000000
+#define GS_MAX_SETTINGS     32
+
+#define LOAD_MAX_SAMPLES    4000000
+
+
+// Custom data types
+// Everything the aggregator knows about one vehicle, kept across reconnects
+typedef struct Gs_Unit{
+    uint16_t unit_id;
+    uint8_t used;
+    uint8_t seq_valid;
+    uint16_t next_seq;                      // Expected seq of the next frame
+    uint16_t conns;                         // More than 1 means two vehicles share the ID
+    uint64_t frames;
+    uint64_t seq_gaps;
+    int64_t last_rx_us;
+    int64_t max_interval_us;                // Longest time between two reads with frames
+    uint8_t cfg_acked;                      // The vehicle took the -c settings
+} gs_unit_t;
+
+// One integer field of laelaps_config_t that serve can set
+typedef struct Gs_Cfg_Field{
+    const char *name;
+    uint16_t offset;
+    uint8_t size;
+} gs_cfg_field_t;
+
+// One -c setting
+typedef struct Gs_Setting{
+    const gs_cfg_field_t *field;
+    int64_t value;
+} gs_setting_t;
+
+// One end of a connection, used by both modes
+typedef struct Gs_Conn{
+    int sock;
+    uint8_t rx_buf[GS_BUF_LEN];
+    uint32_t rx_len;
+    uint8_t tx_buf[GS_BUF_LEN];
+    uint32_t tx_len;
+    uint16_t tx_seq;
+    uint16_t unit_id;
+    gs_unit_t *unit;                        // Set by the first frame, serve only
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t dropped;                       // Frames that did not fit in tx_buf
+} gs_conn_t;
+
+// One vehicle played by load. Sends through the firmware's connection,
+// reads the echoes like serve reads frames
+typedef struct Load_Vehicle{
+    tcp_conn_t conn;
+    gs_conn_t rx;
+} load_vehicle_t;
+
+
+// Global to this file
+static volatile sig_atomic_t gs_stop = 0;
+
+// The vehicle lays out the struct like x86, see main/telemetry.h
+#define GS_CFG_FIELD(f)     { #f, offsetof(laelaps_config_t, f), sizeof(((laelaps_config_t *) 0)->f) }
+static const gs_cfg_field_t gs_cfg_fields[] = {
+    GS_CFG_FIELD(gps_baud),
+    GS_CFG_FIELD(control_period_us),
+    GS_CFG_FIELD(control_step_deg),
+    GS_CFG_FIELD(control_jitter_budget_us),
+    GS_CFG_FIELD(control_record),
+    GS_CFG_FIELD(failsafe_enable),
+    GS_CFG_FIELD(failsafe_action),
+    GS_CFG_FIELD(failsafe_min_sats),
+    GS_CFG_FIELD(failsafe_fix_timeout_ms),
+    GS_CFG_FIELD(failsafe_link_timeout_ms),
+    GS_CFG_FIELD(tlm_port),
+    GS_CFG_FIELD(ota_port),
+    GS_CFG_FIELD(fleet_num_slots),
+    GS_CFG_FIELD(fleet_slot),
+    GS_CFG_FIELD(fleet_frame_ms),
+    GS_CFG_FIELD(tlm_batch_ms),
+};
+
+
+// Now_us
+// Returns CLOCK_MONOTONIC in microseconds
+static int64_t Now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+// On_Signal
+// Stops the main loop of either mode so the summary still gets printed
+static void On_Signal(int sig){
+    gs_stop = 1;
+}
+
+
+// Set_Nonblocking
+// Returns 0 on success, -1 on error
+static int Set_Nonblocking(int sock){
+    int flags = fcntl(sock, F_GETFL);
+    if(flags < 0) return -1;
+    return fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+}
+
+
+// Queue_Frame
+// Appends one frame to a connection's TX buffer
+// Returns 0 on success, -1 if it does not fit (nothing appended)
+static int Queue_Frame(gs_conn_t *c, uint8_t type, uint16_t seq, uint16_t unit_id, int64_t tx_time_us, const void *payload, uint16_t len){
+    tlm_header_t header = {
+        .magic = TLM_MAGIC,
+        .version = TLM_VERSION,
+        .type = type,
+        .length = len,
+        .seq = seq,
+        .unit_id = unit_id,
+        .tx_time_us = tx_time_us,
+    };
+
+    if(c->tx_len + sizeof(header) + len > GS_BUF_LEN){
+        c->dropped++;
+        return -1;
+    }
+    memcpy(&c->tx_buf[c->tx_len], &header, sizeof(header));
+    memcpy(&c->tx_buf[c->tx_len + sizeof(header)], payload, len);
+    c->tx_len += sizeof(header) + len;
+    return 0;
+}
+
+
+// Flush_Conn
+// Sends as much of the TX buffer as the socket takes
+// Returns 0 on success, -1 if the connection failed
+static int Flush_Conn(gs_conn_t *c){
+    ssize_t n;
+
+    while(c->tx_len){
+        n = send(c->sock, c->tx_buf, c->tx_len, MSG_NOSIGNAL);
+        if(n < 0){
+            if((errno == EAGAIN) || (errno == EWOULDBLOCK)) return 0;
+            return -1;
+        }
+        memmove(c->tx_buf, &c->tx_buf[n], c->tx_len - n);
+        c->tx_len -= n;
+    }
+    return 0;
+}
+
+
+// Read_Frames
+// Reads what the socket has and calls on_frame for every complete frame
+// rx_us is the time the read returned, shared by all frames of one read
+// Returns 0 on success, -1 if the connection closed or sent garbage
+static int Read_Frames(gs_conn_t *c, void (*on_frame)(gs_conn_t *, const tlm_header_t *, const uint8_t *, int64_t)){
+    const tlm_header_t *header;
+    uint32_t off = 0;
+    int64_t rx_us;
+    ssize_t n;
+
+    n = recv(c->sock, &c->rx_buf[c->rx_len], GS_BUF_LEN - c->rx_len, 0);
+    if(n == 0) return -1;
+    if(n < 0) return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+    rx_us = Now_us();
+    c->rx_len += n;
+    c->bytes += n;
+
+    while(c->rx_len - off >= sizeof(tlm_header_t)){
+        header = (const tlm_header_t *) &c->rx_buf[off];
+        if((header->magic != TLM_MAGIC) || (header->version != TLM_VERSION) || (header->length > TLM_MAX_PAYLOAD)){
+            fprintf(stderr, "[sock=%d] bad frame header, closing\n", c->sock);
+            return -1;
+        }
+        if(c->rx_len - off < sizeof(tlm_header_t) + header->length) break;
+
+        c->frames++;
+
+        on_frame(c, header, &c->rx_buf[off + sizeof(tlm_header_t)], rx_us);
+        off += sizeof(tlm_header_t) + header->length;
+    }
+
+    memmove(c->rx_buf, &c->rx_buf[off], c->rx_len - off);
+    c->rx_len -= off;
+    return 0;
+}
+
+
+// ---------------------------------------------------------------- serve
+
+static uint32_t serve_echo_every = 1;
+static FILE *serve_replay_file = NULL;
+static gs_unit_t serve_units[GS_MAX_UNITS];
+static uint32_t serve_num_units = 0;
+static gs_setting_t serve_settings[GS_MAX_SETTINGS];
+static uint32_t serve_num_settings = 0;
+static uint8_t serve_persist = 0;
+
+
+// Parse_Setting
+// Adds one name=value argument to the settings sent to vehicles
+// Returns 0 on success, -1 for an unknown name or a value that does not fit
+static int Parse_Setting(const char *arg){
+    const char *eq = strchr(arg, '=');
+    const gs_cfg_field_t *f = NULL;
+    int64_t value;
+    int64_t limit;
+    char *end;
+    uint32_t i;
+
+    if((eq == NULL) || (serve_num_settings >= GS_MAX_SETTINGS)) return -1;
+    for(i = 0; i < sizeof(gs_cfg_fields) / sizeof(gs_cfg_fields[0]); i++){
+        if((strlen(gs_cfg_fields[i].name) == (size_t) (eq - arg)) && !strncmp(gs_cfg_fields[i].name, arg, eq - arg)){
+            f = &gs_cfg_fields[i];
+            break;
+        }
+    }
+    if(f == NULL){
+        fprintf(stderr, "unknown setting %.*s, one of:", (int) (eq - arg), arg);
+        for(i = 0; i < sizeof(gs_cfg_fields) / sizeof(gs_cfg_fields[0]); i++) fprintf(stderr, " %s", gs_cfg_fields[i].name);
+        fprintf(stderr, "\n");
+        return -1;
+    }
+    value = strtoll(eq + 1, &end, 0);
+    // Signed or unsigned, whichever the field is
+    limit = (int64_t) 1 << (f->size * 8);
+    if((*end != '\0') || (value < -limit / 2) || (value >= limit)){
+        fprintf(stderr, "bad value for %s\n", f->name);
+        return -1;
+    }
+    serve_settings[serve_num_settings].field = f;
+    serve_settings[serve_num_settings].value = value;
+    serve_num_settings++;
+    return 0;
+}
+
+
+// Queue_Settings
+// Queues the -c settings as one config update, a patch frame per setting
+static void Queue_Settings(gs_conn_t *c){
+    uint8_t payload[sizeof(tlm_config_t) + sizeof(int64_t)];
+    tlm_config_t patch = { .schema_version = CFG_SCHEMA_VERSION };
+    const gs_setting_t *st;
+    uint32_t i;
+
+    for(i = 0; i < serve_num_settings; i++){
+        st = &serve_settings[i];
+        patch.offset = st->field->offset;
+        patch.flags = 0;
+        if(i == 0) patch.flags |= TLM_CONFIG_BEGIN;
+        if(i == serve_num_settings - 1) patch.flags |= TLM_CONFIG_COMMIT | (serve_persist ? TLM_CONFIG_PERSIST : 0);
+        memcpy(payload, &patch, sizeof(patch));
+        // Little endian, the low bytes are the value at any width
+        memcpy(&payload[sizeof(patch)], &st->value, st->field->size);
+        Queue_Frame(c, TLM_TYPE_CONFIG, c->tx_seq++, c->unit_id, Now_us(), payload, sizeof(patch) + st->field->size);
+    }
+}
+
+
+// Find_Unit
+// Returns the table entry of a unit, creating it on first use
+// Returns NULL if the table is full
+static gs_unit_t* Find_Unit(uint16_t unit_id){
+    uint32_t hash = ((uint32_t) unit_id * 40503u) >> 8;
+    gs_unit_t *u;
+    uint32_t i;
+
+    for(i = 0; i < GS_MAX_UNITS; i++){
+        u = &serve_units[(hash + i) & (GS_MAX_UNITS - 1)];
+        if(u->used && (u->unit_id == unit_id)) return u;
+        if(!u->used){
+            memset(u, 0, sizeof(gs_unit_t));
+            u->used = 1;
+            u->unit_id = unit_id;
+            serve_num_units++;
+            return u;
+        }
+    }
+    return NULL;
+}
+
+
+// Serve_On_Frame
+// Accounts a vehicle frame to its unit and echoes every serve_echo_every-th one
+static void Serve_On_Frame(gs_conn_t *c, const tlm_header_t *header, const uint8_t *payload, int64_t rx_us){
+    gs_unit_t *u = c->unit;
+    tlm_echo_t echo;
+    uint16_t gap;
+
+    if(header->type & 0x80) return;                 // Not a vehicle to ground frame
+
+    if((u == NULL) || (header->unit_id != c->unit_id)){
+        if(u) u->conns--;
+        u = Find_Unit(header->unit_id);
+        if(u == NULL) return;
+        if(u->conns) printf("[sock=%d] unit %u is already connected, duplicate unit ID?\n", c->sock, header->unit_id);
+        u->conns++;
+        c->unit = u;
+        c->unit_id = header->unit_id;
+        if(serve_num_settings && !u->cfg_acked) Queue_Settings(c);
+    }
+    // A seq that went backwards is a restarted vehicle, not 65k lost frames
+    gap = (uint16_t) (header->seq - u->next_seq);
+    if(u->seq_valid && (gap < 0x8000)){
+        u->seq_gaps += gap;
+    }
+    if(u->last_rx_us && (rx_us != u->last_rx_us) && (rx_us - u->last_rx_us > u->max_interval_us)){
+        u->max_interval_us = rx_us - u->last_rx_us;
+    }
+    u->next_seq = header->seq + 1;
+    u->seq_valid = 1;
+    u->last_rx_us = rx_us;
+    u->frames++;
+
+    if((header->type == TLM_TYPE_CONFIG_ACK) && (header->length == sizeof(tlm_config_ack_t))){
+        tlm_config_ack_t ack;
+        memcpy(&ack, payload, sizeof(ack));
+        u->cfg_acked = (ack.err == 0);
+        printf("[sock=%d] unit %u %s config (0x%x), version %u active\n", c->sock, header->unit_id,
+               u->cfg_acked ? "took" : "rejected", (unsigned) ack.err, ack.version);
+    }
+
+    if((header->type == TLM_TYPE_REPLAY) && serve_replay_file){
+        fwrite(header, sizeof(tlm_header_t), 1, serve_replay_file);
+        fwrite(payload, header->length, 1, serve_replay_file);
+    }
+
+    if(c->frames % serve_echo_every) return;
+
+    echo.seq = header->seq;
+    echo.vehicle_tx_us = header->tx_time_us;
+    echo.ground_rx_us = rx_us;
+    echo.ground_tx_us = Now_us();                   // Queued, the flush follows in the same loop pass
+    Queue_Frame(c, TLM_TYPE_ECHO, header->seq, header->unit_id, echo.ground_tx_us, &echo, sizeof(echo));
+}
+
+
+// Print_Units
+// Prints the per unit summary, in table order
+static void Print_Units(void){
+    gs_unit_t *u;
+    uint32_t i;
+
+    printf("%u units\n unit    frames   seq gaps  max interval us\n", serve_num_units);
+    for(i = 0; i < GS_MAX_UNITS; i++){
+        u = &serve_units[i];
+        if(!u->used) continue;
+        printf("%5u %9llu %10llu %16lld\n", u->unit_id, (unsigned long long) u->frames,
+               (unsigned long long) u->seq_gaps, (long long) u->max_interval_us);
+    }
+}
+
+
+// Serve
+// Runs the ground station until interrupted
+static int Serve(uint16_t port){
+    static gs_conn_t clients[GS_MAX_CLIENTS];
+    struct pollfd fds[GS_MAX_CLIENTS + 1];
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    uint64_t frames_total = 0;
+    uint64_t bytes_total = 0;
+    uint64_t last_frames = 0;
+    uint64_t last_bytes = 0;
+    uint64_t gaps;
+    uint64_t dropped;
+    int64_t next_report = Now_us() + GS_REPORT_US;
+    int64_t now;
+    int num_clients = 0;
+    int listen_sock;
+    int sock;
+    int one = 1;
+    int i;
+
+    listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if((bind(listen_sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(listen_sock, GS_MAX_CLIENTS) < 0)){
+        perror("bind/listen");
+        return 1;
+    }
+    Set_Nonblocking(listen_sock);
+    printf("Listening on port %u, echoing every %u frame(s)\n", port, serve_echo_every);
+
+    while(!gs_stop){
+        fds[0].fd = listen_sock;
+        fds[0].events = POLLIN;
+        for(i = 0; i < num_clients; i++){
+            fds[i + 1].fd = clients[i].sock;
+            fds[i + 1].events = POLLIN | (clients[i].tx_len ? POLLOUT : 0);
+        }
+        if(poll(fds, num_clients + 1, 100) < 0){
+            if(errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        if(fds[0].revents & POLLIN){
+            while((num_clients < GS_MAX_CLIENTS) && ((sock = accept(listen_sock, NULL, NULL)) >= 0)){
+                Set_Nonblocking(sock);
+                setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                memset(&clients[num_clients], 0, sizeof(gs_conn_t));
+                clients[num_clients].sock = sock;
+                num_clients++;
+                printf("[sock=%d] vehicle connected, %d total\n", sock, num_clients);
+            }
+        }
+
+        for(i = num_clients - 1; i >= 0; i--){
+            if(!fds[i + 1].revents) continue;
+            if(((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) && (Read_Frames(&clients[i], Serve_On_Frame) < 0))
+               || (Flush_Conn(&clients[i]) < 0)){
+                printf("[sock=%d] unit %u gone after %llu frames\n", clients[i].sock,
+                       clients[i].unit_id, (unsigned long long) clients[i].frames);
+                if(clients[i].unit) clients[i].unit->conns--;
+                close(clients[i].sock);
+                frames_total += clients[i].frames;
+                bytes_total += clients[i].bytes;
+                clients[i] = clients[--num_clients];
+            }
+        }
+
+        now = Now_us();
+        if(now >= next_report){
+            uint64_t frames = frames_total;
+            uint64_t bytes = bytes_total;
+            gaps = 0;
+            dropped = 0;
+            for(i = 0; i < num_clients; i++){
+                frames += clients[i].frames;
+                bytes += clients[i].bytes;
+                dropped += clients[i].dropped;
+            }
+            for(i = 0; i < GS_MAX_UNITS; i++){
+                gaps += serve_units[i].seq_gaps;
+            }
+            printf("%d vehicles  %8llu frames/s  %10llu B/s  %llu seq gaps  %llu echoes dropped\n", num_clients,
+                   (unsigned long long) (frames - last_frames), (unsigned long long) (bytes - last_bytes),
+                   (unsigned long long) gaps, (unsigned long long) dropped);
+            fflush(stdout);
+            last_frames = frames;
+            last_bytes = bytes;
+            next_report += GS_REPORT_US;
+        }
+    }
+
+    for(i = 0; i < num_clients; i++) close(clients[i].sock);
+    close(listen_sock);
+    if(serve_replay_file) fclose(serve_replay_file);
+    Print_Units();
+    return 0;
+}
+
+
+// ---------------------------------------------------------------- load
+
+static int32_t *load_rtt_us;
+static int32_t *load_oneway_us;
+static uint32_t load_num_samples = 0;
+
+
+// Load_On_Frame
+// Records the latency of one echo
+static void Load_On_Frame(gs_conn_t *c, const tlm_header_t *header, const uint8_t *payload, int64_t rx_us){
+    tlm_echo_t echo;
+
+    if((header->type != TLM_TYPE_ECHO) || (header->length != sizeof(echo))) return;
+    if(load_num_samples >= LOAD_MAX_SAMPLES) return;
+    memcpy(&echo, payload, sizeof(echo));
+    load_rtt_us[load_num_samples] = (int32_t) (rx_us - echo.vehicle_tx_us);
+    load_oneway_us[load_num_samples] = (int32_t) (echo.ground_rx_us - echo.vehicle_tx_us);
+    load_num_samples++;
+}
+
+
+// Compare_I32
+// qsort callback
+static int Compare_I32(const void *a, const void *b){
+    int32_t x = *(const int32_t *) a;
+    int32_t y = *(const int32_t *) b;
+    return (x > y) - (x < y);
+}
+
+
+// Print_Percentiles
+// Sorts samples in place and prints the summary line
+static void Print_Percentiles(const char *name, int32_t *samples, uint32_t n){
+    if(n == 0){
+        printf("%-8s no samples\n", name);
+        return;
+    }
+    qsort(samples, n, sizeof(int32_t), Compare_I32);
+    printf("%-8s p50 %7d  p90 %7d  p99 %7d  p99.9 %7d  max %7d us\n", name,
+           samples[n / 2], samples[(uint64_t) n * 90 / 100], samples[(uint64_t) n * 99 / 100],
+           samples[(uint64_t) n * 999 / 1000], samples[n - 1]);
+}
+
+
+// Load
+// Plays num_vehicles vehicles for seconds, then prints the latency summary
+// Each vehicle stamps a frame when it is generated and writes once every batch frames
+// With slotted set, vehicle i runs i / num_vehicles of a period behind vehicle 0
+static int Load(const char *host, uint16_t port, int num_vehicles, uint16_t first_unit_id, uint8_t slotted,
+                uint32_t rate_hz, uint32_t batch, uint16_t payload_len, uint32_t seconds){
+    static load_vehicle_t vehicles[GS_MAX_CLIENTS];
+    static int64_t next_tick[GS_MAX_CLIENTS];
+    static uint32_t generated[GS_MAX_CLIENTS];
+    static uint8_t payload[TLM_MAX_PAYLOAD];
+    struct pollfd fds[GS_MAX_CLIENTS];
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    tlm_state_t *state = (tlm_state_t *) payload;
+    int64_t period_us = 1000000 / rate_hz;
+    int64_t start_us;
+    int64_t end_us;
+    int64_t wake_us;
+    int64_t now;
+    uint64_t sent = 0;
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;
+    int timeout_ms;
+    int one = 1;
+    int sock;
+    int ret;
+    int i;
+
+    if(inet_pton(AF_INET, host, &addr.sin_addr) != 1){
+        fprintf(stderr, "bad address %s\n", host);
+        return 1;
+    }
+    load_rtt_us = malloc(LOAD_MAX_SAMPLES * sizeof(int32_t));
+    load_oneway_us = malloc(LOAD_MAX_SAMPLES * sizeof(int32_t));
+    if(!load_rtt_us || !load_oneway_us) return 1;
+
+    for(i = 0; i < num_vehicles; i++){
+        memset(&vehicles[i].rx, 0, sizeof(gs_conn_t));
+        Tcp_Conn_Init(&vehicles[i].conn);
+        vehicles[i].conn.unit_id = first_unit_id + i;
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if(connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0){
+            perror("connect");
+            return 1;
+        }
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        Set_Nonblocking(sock);
+        Tcp_Conn_Attach(&vehicles[i].conn, sock);
+        vehicles[i].rx.sock = sock;
+    }
+    printf("%d vehicles (units %u-%u, %s) at %u Hz, %u frame(s) per write, %u byte payload, %u byte TX queue, %u s\n",
+           num_vehicles, first_unit_id, first_unit_id + num_vehicles - 1, slotted ? "slotted" : "unslotted",
+           rate_hz, batch, payload_len, TCP_TX_QUEUE_LEN, seconds);
+
+    start_us = Now_us();
+    end_us = start_us + (int64_t) seconds * 1000000;
+    for(i = 0; i < num_vehicles; i++){
+        next_tick[i] = start_us + (slotted ? period_us * i / num_vehicles : 0);
+        generated[i] = 0;
+    }
+
+    while(!gs_stop){
+        now = Now_us();
+        if(now >= end_us) break;
+
+        wake_us = end_us;
+        for(i = 0; i < num_vehicles; i++){
+            if(now >= next_tick[i]){
+                generated[i]++;
+                state->sats = 10;
+                state->servo[0] = (int16_t) generated[i];
+                // TCP_ERR_BACKPRESSURE drops the frame, counted by the queue like on the vehicle
+                ret = Tcp_Conn_Send_Frame(&vehicles[i].conn, TLM_TYPE_STATE, payload, payload_len);
+                if(ret > 0){
+                    sent++;
+                    bytes += ret;
+                }
+                if(((generated[i] % batch) == 0) && (Tcp_Conn_Flush(&vehicles[i].conn, 0) < 0)) gs_stop = 1;
+                next_tick[i] += period_us;
+            }
+            if(next_tick[i] < wake_us) wake_us = next_tick[i];
+
+            fds[i].fd = vehicles[i].rx.sock;
+            fds[i].events = POLLIN | ((vehicles[i].conn.used && ((generated[i] % batch) == 0)) ? POLLOUT : 0);
+        }
+
+        timeout_ms = (int) ((wake_us - Now_us()) / 1000);
+        if(timeout_ms < 0) timeout_ms = 0;
+        if(poll(fds, num_vehicles, timeout_ms) < 0){
+            if(errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        for(i = 0; i < num_vehicles; i++){
+            if(fds[i].revents & POLLOUT) Tcp_Conn_Flush(&vehicles[i].conn, 0);
+            if((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && (Read_Frames(&vehicles[i].rx, Load_On_Frame) < 0)){
+                fprintf(stderr, "[sock=%d] ground station closed the connection\n", vehicles[i].rx.sock);
+                gs_stop = 1;
+            }
+        }
+    }
+
+    // Give the last echoes a moment to come back
+    end_us = Now_us();
+    while(Now_us() - end_us < 200000){
+        for(i = 0; i < num_vehicles; i++){
+            Tcp_Conn_Flush(&vehicles[i].conn, 0);
+            fds[i].fd = vehicles[i].rx.sock;
+            fds[i].events = POLLIN;
+        }
+        if(poll(fds, num_vehicles, 20) <= 0) continue;
+        for(i = 0; i < num_vehicles; i++){
+            if(fds[i].revents & POLLIN) Read_Frames(&vehicles[i].rx, Load_On_Frame);
+        }
+    }
+
+    for(i = 0; i < num_vehicles; i++){
+        dropped += vehicles[i].conn.dropped_frames;
+        Tcp_Conn_Close(&vehicles[i].conn);
+    }
+    now = end_us - start_us;
+    printf("sent %llu frames (%.1f frames/s, %.1f kB/s), dropped %llu, %u echoes\n",
+           (unsigned long long) sent, sent * 1e6 / now, bytes * 1e3 / now, (unsigned long long) dropped, load_num_samples);
+    Print_Percentiles("rtt", load_rtt_us, load_num_samples);
+    Print_Percentiles("one-way", load_oneway_us, load_num_samples);
+
+    free(load_rtt_us);
+    free(load_oneway_us);
+    return 0;
+}
+
+
+// Usage
+static int Usage(const char *prog){
+    fprintf(stderr, "usage: %s serve [-p port] [-e echo_every] [-w replay_file] [-c name=value ...] [-P]\n"
+                    "       %s load [-a addr] [-p port] [-v vehicles] [-r rate_hz] [-b batch] [-s payload_bytes] [-t seconds]\n"
+                    "               [-u first_unit_id] [-S]\n",
+            prog, prog);
+    return 2;
+}
+
+
+int main(int argc, char **argv){
+    const char *host = "127.0.0.1";
+    uint16_t port = GS_DEFAULT_PORT;
+    int vehicles = 1;
+    uint32_t rate_hz = 50;
+    uint32_t batch = 1;
+    uint32_t payload_len = sizeof(tlm_state_t);
+    uint32_t seconds = 10;
+    uint16_t first_unit_id = 1;
+    uint8_t slotted = 0;
+    int opt;
+
+    if(argc < 2) return Usage(argv[0]);
+    optind = 2;
+    while((opt = getopt(argc, argv, "a:p:e:w:c:Pv:r:b:s:t:u:S")) != -1){
+        switch(opt){
+        case 'a': host = optarg; break;
+        case 'p': port = (uint16_t) atoi(optarg); break;
+        case 'e': serve_echo_every = (uint32_t) atoi(optarg); break;
+        case 'w':
+            serve_replay_file = fopen(optarg, "ab");
+            if(serve_replay_file == NULL){
+                perror(optarg);
+                return 1;
+            }
+        break;
+        case 'c':
+            if(Parse_Setting(optarg) < 0) return Usage(argv[0]);
+        break;
+        case 'P': serve_persist = 1; break;
+        case 'v': vehicles = atoi(optarg); break;
+        case 'r': rate_hz = (uint32_t) atoi(optarg); break;
+        case 'b': batch = (uint32_t) atoi(optarg); break;
+        case 's': payload_len = (uint32_t) atoi(optarg); break;
+        case 't': seconds = (uint32_t) atoi(optarg); break;
+        case 'u': first_unit_id = (uint16_t) atoi(optarg); break;
+        case 'S': slotted = 1; break;
+        default: return Usage(argv[0]);
+        }
+    }
+    if((serve_echo_every == 0) || (vehicles < 1) || (vehicles > GS_MAX_CLIENTS) || (rate_hz == 0) || (rate_hz > 1000000)
+       || (batch == 0) || (payload_len < sizeof(tlm_state_t)) || (payload_len > TLM_MAX_PAYLOAD)){
+        return Usage(argv[0]);
+    }
+
+    signal(SIGINT, On_Signal);
+    signal(SIGTERM, On_Signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    if(!strcmp(argv[1], "serve")) return Serve(port);
+    if(!strcmp(argv[1], "load")) return Load(host, port, vehicles, first_unit_id, slotted, rate_hz, batch, (uint16_t) payload_len, seconds);
+    return Usage(argv[0]);
+}
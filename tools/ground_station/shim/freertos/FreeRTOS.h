@@ -0,0 +1,27 @@
+/*
+This file holds the FreeRTOS basics main/tcp_conn.c uses, mapped to POSIX
+Only enough for the ground station to build the firmware's connection code
+on the host, see tools/ground_station/ground_station.c
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+#ifndef SHIM_FREERTOS_H
+#define SHIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define portMAX_DELAY       ((TickType_t) 0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (ms))
+
+#endif
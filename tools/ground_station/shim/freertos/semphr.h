@@ -0,0 +1,34 @@
+/*
+This file holds the FreeRTOS mutex calls main/tcp_conn.c uses, mapped to pthreads
+Timeouts are not supported, every take waits forever like the firmware's
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+#ifndef SHIM_SEMPHR_H
+#define SHIM_SEMPHR_H
+
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+typedef pthread_mutex_t StaticSemaphore_t;
+typedef pthread_mutex_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buf){
+    pthread_mutex_init(buf, NULL);
+    return buf;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks){
+    (void) ticks;
+    return (pthread_mutex_lock(sem) == 0) ? pdTRUE : pdFALSE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem){
+    return (pthread_mutex_unlock(sem) == 0) ? pdTRUE : pdFALSE;
+}
+
+#endif
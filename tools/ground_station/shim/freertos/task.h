@@ -0,0 +1,24 @@
+/*
+This file holds the FreeRTOS task calls main/tcp_conn.c uses
+The ground station polls its sockets, so nothing waits on notifications
+and giving one does nothing
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+#ifndef SHIM_TASK_H
+#define SHIM_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task){
+    (void) task;
+    return pdPASS;
+}
+
+#endif
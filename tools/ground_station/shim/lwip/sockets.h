@@ -0,0 +1,22 @@
+/*
+This file holds the lwIP socket names main/tcp_conn.c uses, mapped to POSIX
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+#ifndef SHIM_LWIP_SOCKETS_H
+#define SHIM_LWIP_SOCKETS_H
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define lwip_writev     writev
+
+#endif
@@ -0,0 +1,389 @@
+/*
+Host side benchmark for the NMEA parsers in main/nmea.c and the UBX parser in ubx.c
+Generates a set of sentences with valid checksums, checks the GGA results
+against the string splitting parser gps.c used before, then reports the
+time per sentence and sentences per second for each message type
+
+The numbers are host numbers. They are only useful relative to each other,
+e.g. old vs new GGA parser, or before vs after a change to a schema
+
+Build:  gcc -O2 -Wall -o nmea_bench tools/nmea_bench/nmea_bench.c tools/nmea_bench/ubx.c main/nmea.c -lm
+Usage:  nmea_bench [-n iterations]
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../main/nmea.h"
+#include "ubx.h"
+
+#define BENCH_SENTENCES     256             // Per type, cycled through so the data is not always the same
+#define BENCH_LINE_LEN      128
+#define BENCH_DEFAULT_ITERS 2000            // Passes over each set
+
+// Copy of the GGA parser from gps.c before the schemas, used as the baseline
+#define LEGACY_FIELD_MAX_LEN    12
+#define LEGACY_FIELDS           9
+
+
+// Custom data types
+typedef struct Bench_Line{
+    char text[BENCH_LINE_LEN];
+    uint16_t len;
+} bench_line_t;
+
+typedef struct Legacy_GGA{
+    float lat;
+    float lon;
+    float altitude;
+    float hdop;
+    uint8_t utc_hour;
+    uint8_t utc_minute;
+    uint8_t utc_second;
+    uint8_t sats;
+    uint16_t utc_millisecond;
+} legacy_gga_t;
+
+static bench_line_t bench_gga[BENCH_SENTENCES];
+static bench_line_t bench_rmc[BENCH_SENTENCES];
+static bench_line_t bench_vtg[BENCH_SENTENCES];
+static bench_line_t bench_gsa[BENCH_SENTENCES];
+static bench_line_t bench_mixed[BENCH_SENTENCES];
+static uint8_t bench_ubx[BENCH_SENTENCES][UBX_HEADER_LEN + 92 + UBX_CHECKSUM_LEN];
+
+// Results go here so the compiler cannot drop the parsing
+static volatile uint32_t bench_sink;
+
+
+static int64_t Now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Finish_Line
+// Appends "*hh\r\n" to a sentence body starting with '$'
+static void Finish_Line(bench_line_t *l, int body_len){
+    uint8_t sum = 0;
+    int i;
+    for(i = 1; i < body_len; i++) sum ^= (uint8_t) l->text[i];
+    l->len = (uint16_t) (body_len + snprintf(l->text + body_len, BENCH_LINE_LEN - body_len, "*%02X\r\n", sum));
+}
+
+// Format_Deg_Min
+// Writes degrees as ddmm.mmmmm (or dddmm.mmmmm) and the hemisphere letter
+static int Format_Deg_Min(char *out, size_t size, double deg, int deg_digits, char pos, char neg){
+    char hemi = (deg < 0) ? neg : pos;
+    double a = fabs(deg);
+    int whole = (int) a;
+    double minutes = (a - whole) * 60.0;
+    return snprintf(out, size, "%0*d%08.5f,%c", deg_digits, whole, minutes, hemi);
+}
+
+static void Generate(void){
+    char lat[24];
+    char lon[24];
+    int i;
+    int n;
+    uint8_t *f;
+    uint16_t ck_len = UBX_HEADER_LEN + 92;
+    uint8_t ck_a;
+    uint8_t ck_b;
+    int j;
+
+    srand(1);
+    for(i = 0; i < BENCH_SENTENCES; i++){
+        double la = (rand() % 18000000 - 9000000) / 100000.0;
+        double lo = (rand() % 36000000 - 18000000) / 100000.0;
+        int hh = rand() % 24, mm = rand() % 60, ss = rand() % 60, cs = rand() % 100;
+        float alt = (rand() % 100000) / 10.0f - 500.0f;
+        float hdop = (rand() % 500) / 100.0f;
+        float knots = (rand() % 10000) / 100.0f;
+        float course = (rand() % 36000) / 100.0f;
+        int sats = rand() % 24;
+
+        Format_Deg_Min(lat, sizeof(lat), la, 2, 'N', 'S');
+        Format_Deg_Min(lon, sizeof(lon), lo, 3, 'E', 'W');
+
+        n = snprintf(bench_gga[i].text, BENCH_LINE_LEN, "$GPGGA,%02d%02d%02d.%02d,%s,%s,1,%02d,%.2f,%.1f,M,46.9,M,,",
+                     hh, mm, ss, cs, lat, lon, sats, hdop, alt);
+        Finish_Line(&bench_gga[i], n);
+
+        n = snprintf(bench_rmc[i].text, BENCH_LINE_LEN, "$GNRMC,%02d%02d%02d.%02d,A,%s,%s,%.2f,%.2f,191026,,,A",
+                     hh, mm, ss, cs, lat, lon, knots, course);
+        Finish_Line(&bench_rmc[i], n);
+
+        n = snprintf(bench_vtg[i].text, BENCH_LINE_LEN, "$GPVTG,%.2f,T,,M,%.2f,N,%.2f,K,A",
+                     course, knots, knots * 1.852f);
+        Finish_Line(&bench_vtg[i], n);
+
+        n = snprintf(bench_gsa[i].text, BENCH_LINE_LEN, "$GNGSA,A,3,01,02,03,04,05,06,07,08,,,,,%.2f,%.2f,%.2f,1",
+                     hdop * 1.5f, hdop, hdop * 1.2f);
+        Finish_Line(&bench_gsa[i], n);
+
+        // Roughly what a receiver sends each second
+        switch(i % 4){
+        case 0: bench_mixed[i] = bench_gga[i]; break;
+        case 1: bench_mixed[i] = bench_rmc[i]; break;
+        case 2: bench_mixed[i] = bench_vtg[i]; break;
+        default: bench_mixed[i] = bench_gsa[i]; break;
+        }
+
+        f = bench_ubx[i];
+        for(j = 0; j < UBX_HEADER_LEN + 92; j++) f[j] = (uint8_t) rand();
+        f[0] = UBX_SYNC_1;
+        f[1] = UBX_SYNC_2;
+        f[2] = 0x01;
+        f[3] = 0x07;
+        f[4] = 92;
+        f[5] = 0;
+        ck_a = 0;
+        ck_b = 0;
+        for(j = 2; j < ck_len; j++){
+            ck_a += f[j];
+            ck_b += ck_a;
+        }
+        f[ck_len] = ck_a;
+        f[ck_len + 1] = ck_b;
+    }
+}
+
+
+// Legacy parser, as it was in gps.c
+static uint8_t Legacy_Str_2_Int(char* array, uint8_t s_idx, uint8_t len){
+    uint8_t i;
+    uint8_t output = 0;
+    for(i = 0; i < len; i++){
+        if((array[s_idx + i] < '0') || (array[s_idx + i] > '9')) return 0;
+        output *= 10;
+        output += array[s_idx + i] - '0';
+    }
+    return output;
+}
+
+static int8_t Legacy_Get_GGA_Start(const char* array, uint16_t len_to_scan, uint16_t* s_idx_ptr, uint16_t* len_target_str){
+    uint16_t i;
+    uint8_t found_start = 0;
+    uint8_t cmp_str_idx = 0;
+    const char cmp_str[7] = "$GPGGA,";
+
+    for(i = 0; i < len_to_scan; i++){
+        if(array[i] == cmp_str[cmp_str_idx]) cmp_str_idx++;
+        else cmp_str_idx = 0;
+        if(cmp_str_idx >= 7){
+            cmp_str_idx = 0;
+            found_start = 1;
+            *s_idx_ptr = i + 1;
+        }
+        if(found_start && (array[i] == '\n')){
+            *len_target_str = i - *s_idx_ptr;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int8_t Legacy_Extract(const char *data, uint16_t start_idx, uint16_t len, legacy_gga_t *out){
+    uint16_t i;
+    uint8_t num_commas = 0;
+    uint8_t gps_str_ptr = 0;
+    char gps_strings[LEGACY_FIELDS][LEGACY_FIELD_MAX_LEN];
+    float lattitude = 0.0;
+    float longitude = 0.0;
+    uint16_t ms_scale = 100;
+
+    memset(gps_strings, 0, sizeof(gps_strings));
+    for(i = 0; i < len; i++){
+        if(data[i + start_idx] == ','){
+            num_commas++;
+            gps_str_ptr = 0;
+            if(num_commas >= LEGACY_FIELDS) break;
+            continue;
+        }
+        if(num_commas < LEGACY_FIELDS){
+            gps_strings[num_commas][gps_str_ptr] = data[i + start_idx];
+            gps_str_ptr++;
+        }
+    }
+    if(gps_strings[0][0] == '\0') return 0;
+
+    out->utc_hour = Legacy_Str_2_Int(gps_strings[0], 0, 2);
+    out->utc_minute = Legacy_Str_2_Int(gps_strings[0], 2, 2);
+    out->utc_second = Legacy_Str_2_Int(gps_strings[0], 4, 2);
+    out->utc_millisecond = 0;
+    if(gps_strings[0][6] == '.'){
+        for(i = 7; (i < 10) && (gps_strings[0][i] >= '0') && (gps_strings[0][i] <= '9'); i++){
+            out->utc_millisecond += (gps_strings[0][i] - '0') * ms_scale;
+            ms_scale /= 10;
+        }
+    }
+    lattitude += Legacy_Str_2_Int(gps_strings[1], 0, 2);
+    lattitude += (atof(&gps_strings[1][2])) / 60;
+    if(gps_strings[2][0] == 'S') lattitude *= -1;
+    longitude += Legacy_Str_2_Int(gps_strings[3], 0, 3);
+    longitude += (atof(&gps_strings[3][3])) / 60;
+    if(gps_strings[4][0] == 'W') longitude *= -1;
+    out->lat = lattitude;
+    out->lon = longitude;
+    out->sats = Legacy_Str_2_Int(gps_strings[6], 0, 2);
+    out->hdop = atof(gps_strings[7]);
+    out->altitude = atof(gps_strings[8]);
+    return 1;
+}
+
+static uint32_t Legacy_Parse(const bench_line_t *l, legacy_gga_t *out){
+    uint16_t start;
+    uint16_t len;
+    if(!Legacy_Get_GGA_Start(l->text, l->len, &start, &len)) return 0;
+    return (uint32_t) Legacy_Extract(l->text, start, len, out);
+}
+
+
+// Check
+// Compares the new GGA parser with the legacy one, and the others with the generator
+// Returns the number of mismatches
+static int Check(void){
+    nmea_msg_t msg;
+    ubx_msg_t ubx;
+    legacy_gga_t old;
+    bench_line_t bad;
+    int errors = 0;
+    int i;
+
+    for(i = 0; i < BENCH_SENTENCES; i++){
+        if((Nmea_Parse_Line(bench_gga[i].text, bench_gga[i].len, &msg) != NMEA_MSG_GGA) || !Legacy_Parse(&bench_gga[i], &old)){
+            printf("GGA %d not parsed: %s", i, bench_gga[i].text);
+            errors++;
+            continue;
+        }
+        if((fabsf(msg.gga.lat - old.lat) > 1e-5f) || (fabsf(msg.gga.lon - old.lon) > 1e-5f)
+           || (fabsf(msg.gga.altitude - old.altitude) > 1e-3f) || (fabsf(msg.gga.hdop - old.hdop) > 1e-4f)
+           || (msg.gga.sats != old.sats) || (msg.gga.time.hour != old.utc_hour) || (msg.gga.time.minute != old.utc_minute)
+           || (msg.gga.time.second != old.utc_second) || (msg.gga.time.millisecond != old.utc_millisecond)){
+            printf("GGA %d mismatch: %s  new %.6f %.6f %.1f %.2f %u %02u:%02u:%02u.%03u\n  old %.6f %.6f %.1f %.2f %u %02u:%02u:%02u.%03u\n",
+                   i, bench_gga[i].text,
+                   msg.gga.lat, msg.gga.lon, msg.gga.altitude, msg.gga.hdop, msg.gga.sats,
+                   msg.gga.time.hour, msg.gga.time.minute, msg.gga.time.second, msg.gga.time.millisecond,
+                   old.lat, old.lon, old.altitude, old.hdop, old.sats,
+                   old.utc_hour, old.utc_minute, old.utc_second, old.utc_millisecond);
+            errors++;
+        }
+        if((Nmea_Parse_Line(bench_rmc[i].text, bench_rmc[i].len, &msg) != NMEA_MSG_RMC) || (msg.rmc.status != 'A')
+           || !msg.rmc.date.valid || (msg.rmc.date.year != 26)){
+            printf("RMC %d: %s", i, bench_rmc[i].text);
+            errors++;
+        }
+        if(Nmea_Parse_Line(bench_vtg[i].text, bench_vtg[i].len, &msg) != NMEA_MSG_VTG){
+            printf("VTG %d: %s", i, bench_vtg[i].text);
+            errors++;
+        }
+        if((Nmea_Parse_Line(bench_gsa[i].text, bench_gsa[i].len, &msg) != NMEA_MSG_GSA) || (msg.gsa.fix_type != 3)){
+            printf("GSA %d: %s", i, bench_gsa[i].text);
+            errors++;
+        }
+        if((Ubx_Parse_Frame(bench_ubx[i], sizeof(bench_ubx[i]), &ubx) != UBX_MSG_NAV_PVT)
+           || (memcmp(&ubx.nav_pvt.lat_1e7, &bench_ubx[i][UBX_HEADER_LEN + 28], 4) != 0)){
+            printf("UBX %d not parsed\n", i);
+            errors++;
+        }
+    }
+
+    // A corrupt checksum must be rejected
+    bad = bench_gga[0];
+    bad.text[10] ^= 1;
+    if(Nmea_Parse_Line(bad.text, bad.len, &msg) != NMEA_NONE){
+        printf("Corrupt GGA accepted\n");
+        errors++;
+    }
+#ifndef NMEA_CHECKSUM_OPTIONAL
+    // So must a line cut off before its checksum
+    bad = bench_gga[0];
+    bad.len = (uint16_t) (strchr(bad.text, '*') - bad.text);
+    if(Nmea_Parse_Line(bad.text, bad.len, &msg) != NMEA_NONE){
+        printf("GGA without checksum accepted\n");
+        errors++;
+    }
+#endif
+    return errors;
+}
+
+
+// Bench
+// Times parse over the set and prints ns per sentence and sentences per second
+static void Bench(const char *name, uint32_t iterations, uint32_t (*parse)(uint32_t)){
+    uint32_t it;
+    uint32_t i;
+    uint32_t sink = 0;
+    int64_t start = Now_ns();
+    double ns;
+
+    for(it = 0; it < iterations; it++){
+        for(i = 0; i < BENCH_SENTENCES; i++) sink += parse(i);
+    }
+    ns = (double) (Now_ns() - start) / ((double) iterations * BENCH_SENTENCES);
+    bench_sink = sink;
+    printf("%-14s %8.1f ns  %12.0f /s\n", name, ns, 1e9 / ns);
+}
+
+static uint32_t Bench_Legacy_GGA(uint32_t i){
+    legacy_gga_t old;
+    return Legacy_Parse(&bench_gga[i], &old) + old.sats;
+}
+
+static uint32_t Bench_Parse(const bench_line_t *l){
+    nmea_msg_t msg;
+    return (uint32_t) Nmea_Parse_Line(l->text, l->len, &msg) + msg.gga.time.second;
+}
+
+static uint32_t Bench_GGA(uint32_t i){ return Bench_Parse(&bench_gga[i]); }
+static uint32_t Bench_RMC(uint32_t i){ return Bench_Parse(&bench_rmc[i]); }
+static uint32_t Bench_VTG(uint32_t i){ return Bench_Parse(&bench_vtg[i]); }
+static uint32_t Bench_GSA(uint32_t i){ return Bench_Parse(&bench_gsa[i]); }
+static uint32_t Bench_Mixed(uint32_t i){ return Bench_Parse(&bench_mixed[i]); }
+
+static uint32_t Bench_UBX(uint32_t i){
+    ubx_msg_t msg;
+    return (uint32_t) Ubx_Parse_Frame(bench_ubx[i], sizeof(bench_ubx[i]), &msg) + msg.nav_pvt.sats;
+}
+
+
+int main(int argc, char **argv){
+    uint32_t iterations = BENCH_DEFAULT_ITERS;
+    int opt;
+    int errors;
+
+    while((opt = getopt(argc, argv, "n:")) != -1){
+        if(opt == 'n') iterations = (uint32_t) atoi(optarg);
+        else{
+            fprintf(stderr, "Usage: %s [-n iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Generate();
+    errors = Check();
+    if(errors){
+        printf("%d mismatches\n", errors);
+        return 1;
+    }
+    printf("Parsers agree on %d sentences per type\n\n", BENCH_SENTENCES);
+
+    Bench("GGA legacy", iterations, Bench_Legacy_GGA);
+    Bench("GGA", iterations, Bench_GGA);
+    Bench("RMC", iterations, Bench_RMC);
+    Bench("VTG", iterations, Bench_VTG);
+    Bench("GSA", iterations, Bench_GSA);
+    Bench("Mixed", iterations, Bench_Mixed);
+    Bench("UBX NAV-PVT", iterations, Bench_UBX);
+    return 0;
+}
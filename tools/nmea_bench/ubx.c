@@ -0,0 +1,59 @@
+/*
+This file holds the UBX parser generated from the schemas in ubx.h
+Host side only, see ubx.h
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+// Include Header Libraries
+#include <stdint.h>
+#include <string.h>
+#include "ubx.h"
+
+
+// Ubx_Parse_Frame
+// Parses one complete UBX frame starting at the sync characters
+// Returns the type stored in out, UBX_NONE for unknown, short or corrupt frames
+ubx_msg_type_t Ubx_Parse_Frame(const uint8_t *frame, uint16_t len, ubx_msg_t *out){
+    const uint8_t *payload = frame + UBX_HEADER_LEN;
+    uint16_t payload_len;
+    uint8_t ck_a = 0;
+    uint8_t ck_b = 0;
+    uint16_t i;
+
+    out->type = UBX_NONE;
+    if((len < UBX_HEADER_LEN + UBX_CHECKSUM_LEN) || (frame[0] != UBX_SYNC_1) || (frame[1] != UBX_SYNC_2)) return UBX_NONE;
+    payload_len = frame[4] | ((uint16_t) frame[5] << 8);
+    if(len < UBX_HEADER_LEN + payload_len + UBX_CHECKSUM_LEN) return UBX_NONE;
+
+    // Fletcher checksum over class, id, length and payload
+    for(i = 2; i < UBX_HEADER_LEN + payload_len; i++){
+        ck_a += frame[i];
+        ck_b += ck_a;
+    }
+    if((ck_a != frame[UBX_HEADER_LEN + payload_len]) || (ck_b != frame[UBX_HEADER_LEN + payload_len + 1])) return UBX_NONE;
+
+#define UBX_COPY_FIELD(offset, ctype, member) \
+    _Static_assert((offset) + sizeof(ctype) <= UBX_PAYLOAD_LEN, #member " is outside the payload"); \
+    memcpy(&msg->member, payload + (offset), sizeof(ctype));
+
+#define UBX_DISPATCH(NAME, name, cls, id, plen) \
+    case ((cls) << 8) | (id): \
+        if(payload_len == (plen)){ \
+            enum { UBX_PAYLOAD_LEN = (plen) }; \
+            ubx_##name##_t *msg = &out->name; \
+            UBX_##NAME(UBX_COPY_FIELD) \
+            out->type = UBX_MSG_##NAME; \
+        } \
+    break;
+
+    switch(((uint16_t) frame[2] << 8) | frame[3]){
+    UBX_MESSAGES(UBX_DISPATCH)
+    default:
+    break;
+    }
+    return out->type;
+}
@@ -0,0 +1,79 @@
+/*
+This file holds the UBX message schemas and the types for ubx.c
+Host side only. The firmware reads NMEA, see main/nmea.h, nothing on the
+vehicle sets the receiver to UBX output. Kept with the bench so the parser
+and its numbers are ready should the GPS task ever switch to UBX
+
+UBX tables list X(offset, ctype, member), payload is little endian like the ESP32
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+#ifndef UBX_H
+#define UBX_H
+
+#include <stdint.h>
+
+// UBX NAV-PVT, navigation position velocity time
+#define UBX_NAV_PVT(X) \
+    X(0,  uint32_t, itow_ms) \
+    X(4,  uint16_t, year) \
+    X(6,  uint8_t,  month) \
+    X(7,  uint8_t,  day) \
+    X(8,  uint8_t,  hour) \
+    X(9,  uint8_t,  minute) \
+    X(10, uint8_t,  second) \
+    X(11, uint8_t,  valid) \
+    X(16, int32_t,  nano) \
+    X(20, uint8_t,  fix_type) \
+    X(23, uint8_t,  sats) \
+    X(24, int32_t,  lon_1e7) \
+    X(28, int32_t,  lat_1e7) \
+    X(36, int32_t,  hmsl_mm) \
+    X(40, uint32_t, hacc_mm) \
+    X(60, int32_t,  gspeed_mms) \
+    X(64, int32_t,  heading_1e5) \
+    X(76, uint16_t, pdop_001)
+
+// All UBX messages the parser knows. X(NAME, name, class, id, payload length)
+#define UBX_MESSAGES(X) \
+    X(NAV_PVT, nav_pvt, 0x01, 0x07, 92)
+
+#define UBX_SYNC_1          0xB5
+#define UBX_SYNC_2          0x62
+#define UBX_HEADER_LEN      6                   // Sync, class, id, length
+#define UBX_CHECKSUM_LEN    2
+
+
+// Custom data types
+// One struct per UBX message, e.g. ubx_nav_pvt_t
+#define UBX_DECL_FIELD(offset, ctype, member) ctype member;
+#define UBX_DECL_MESSAGE(NAME, name, cls, id, len) \
+    typedef struct UBX_##NAME{ UBX_##NAME(UBX_DECL_FIELD) } ubx_##name##_t;
+UBX_MESSAGES(UBX_DECL_MESSAGE)
+
+// Message type codes, UBX_NONE for anything unknown or corrupt
+#define UBX_ENUM(NAME, name, cls, id, len) UBX_MSG_##NAME,
+typedef enum UBX_Msg_Type{
+    UBX_NONE = 0,
+    UBX_MESSAGES(UBX_ENUM)
+    UBX_NUM_TYPES
+} ubx_msg_type_t;
+
+// One parsed UBX message of any type
+#define UBX_UNION_MEMBER(NAME, name, cls, id, len) ubx_##name##_t name;
+typedef struct UBX_Msg{
+    ubx_msg_type_t type;
+    union{
+        UBX_MESSAGES(UBX_UNION_MEMBER)
+    };
+} ubx_msg_t;
+
+
+// Function prototypes
+ubx_msg_type_t Ubx_Parse_Frame(const uint8_t *frame, uint16_t len, ubx_msg_t *out);
+
+#endif
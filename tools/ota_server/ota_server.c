@@ -0,0 +1,465 @@
+/*
+Host side firmware update server for main/ota.c
+Serves one image to every vehicle that asks for it. Vehicles already
+running the image are told there is nothing new
+
+Each 4 KB block of the image is sent in the smallest form the vehicle
+can decode:
+COPY     The vehicle already has the same bytes somewhere in its running
+         image, only the offset is sent. Needs -B with the image the
+         vehicle runs. Found with a rolling hash over every offset, so code
+         that only moved still matches as long as a whole block is unchanged
+DEFLATE  zlib stream of the block, when it is smaller than the block
+RAW      Everything else
+Blocks are encoded once at start up. Vehicles are served one at a time,
+the others time out and ask again on their next poll
+
+The vehicle only boots images signed with the project key, see
+main/ota.h. Serve the signed .bin the build writes, or one signed with
+espsecure.py sign_data. An unsigned image downloads and is then refused
+
+Build:  gcc -O2 -Wall -o ota_server tools/ota_server/ota_server.c -lz
+Usage:  ota_server -f new.bin [-B running.bin] [-p port] [-r]
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <zlib.h>
+#include "../../main/telemetry.h"
+
+#define OTA_DEFAULT_PORT        5761
+#define OTA_IMAGE_MAGIC         0xE9            // First byte of an ESP app image
+#define OTA_SEGMENTS_OFF        1               // esp_image_header_t.segment_count
+#define OTA_HASH_APPENDED_OFF   23              // esp_image_header_t.hash_appended
+#define OTA_HEADER_LEN          24              // sizeof(esp_image_header_t)
+#define OTA_SEGMENT_HEADER_LEN  8               // Load address and length
+#define OTA_MAX_IMAGE_LEN       (16 * 1024 * 1024)
+#define OTA_TABLE_BITS          20              // Rolling hash table, 1M entries
+#define OTA_NO_SRC              UINT32_MAX
+
+// Rolling hash over one block, Rabin-Karp mod 2^32
+#define OTA_HASH_BASE           257u
+
+
+// Custom data types
+// An image file with the SHA-256 esptool appended to it
+typedef struct Ota_Image{
+    uint8_t *data;
+    uint32_t len;
+    const uint8_t *hash;
+} ota_image_t;
+
+// One block of the new image, encoded both ways a vehicle might need
+typedef struct Ota_Block{
+    uint32_t len;
+    uint32_t copy_src;                          // Offset in the base image, OTA_NO_SRC if none
+    uint8_t *deflate;                           // NULL if it does not shrink the block
+    uint16_t deflate_len;
+} ota_block_t;
+
+// Bytes and blocks sent in each encoding, for one session
+typedef struct Ota_Stats{
+    uint32_t blocks[3];
+    uint64_t bytes;
+} ota_stats_t;
+
+
+// Global to this file
+static volatile sig_atomic_t ota_stop = 0;
+static ota_image_t ota_new;
+static ota_image_t ota_base;
+static ota_block_t *ota_blocks;
+static uint32_t ota_num_blocks;
+static uint16_t ota_tx_seq = 0;
+
+
+// Now_us
+// Returns CLOCK_MONOTONIC in microseconds
+static int64_t Now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+// On_Signal
+// Stops accepting vehicles
+static void On_Signal(int sig){
+    ota_stop = 1;
+}
+
+
+// Load_Image
+// Reads an ESP app image built with the hash appended
+// The hash follows the segments and checksum, a signature may follow it
+// Returns 0 on success, -1 on error
+static int Load_Image(const char *path, ota_image_t *img){
+    FILE *f = fopen(path, "rb");
+    uint32_t off = OTA_HEADER_LEN;
+    uint32_t seg_len;
+    long len;
+    int i;
+
+    if(f == NULL){
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if((len <= OTA_HASH_APPENDED_OFF + TLM_OTA_HASH_LEN) || (len > OTA_MAX_IMAGE_LEN)){
+        fprintf(stderr, "%s: not an app image\n", path);
+        fclose(f);
+        return -1;
+    }
+    img->data = malloc(len);
+    img->len = (uint32_t) len;
+    if((img->data == NULL) || (fread(img->data, 1, len, f) != (size_t) len)){
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    if((img->data[0] != OTA_IMAGE_MAGIC) || (img->data[OTA_HASH_APPENDED_OFF] != 1)){
+        fprintf(stderr, "%s: not an app image with an appended hash\n", path);
+        return -1;
+    }
+    for(i = 0; i < img->data[OTA_SEGMENTS_OFF]; i++){
+        if(off + OTA_SEGMENT_HEADER_LEN > img->len) break;
+        memcpy(&seg_len, &img->data[off + 4], sizeof(seg_len));
+        off += OTA_SEGMENT_HEADER_LEN + seg_len;
+    }
+    // Checksum byte, padded to 16 bytes
+    off = (off + 1 + 15) & ~15u;
+    if((i < img->data[OTA_SEGMENTS_OFF]) || (off + TLM_OTA_HASH_LEN > img->len)){
+        fprintf(stderr, "%s: truncated app image\n", path);
+        return -1;
+    }
+    img->hash = &img->data[off];
+    return 0;
+}
+
+
+// Find_Copies
+// Sets copy_src of every block of the new image that appears anywhere in the base image
+// Only whole blocks match. The last, shorter block is matched by its own length
+static void Find_Copies(void){
+    uint32_t table_len = 1u << OTA_TABLE_BITS;
+    uint32_t *table = malloc(table_len * sizeof(uint32_t));
+    uint32_t top = 1;                           // OTA_HASH_BASE^(block - 1), drops the oldest byte
+    uint32_t hash = 0;
+    uint32_t slot;
+    uint32_t src;
+    uint32_t i;
+    uint32_t b;
+    ota_block_t *blk;
+
+    if(table == NULL) return;
+    for(i = 0; i < table_len; i++) table[i] = OTA_NO_SRC;
+    for(i = 1; i < TLM_OTA_BLOCK_LEN; i++) top *= OTA_HASH_BASE;
+
+    // Index every full block sized window of the base, first offset wins
+    if(ota_base.len >= TLM_OTA_BLOCK_LEN){
+        for(i = 0; i < TLM_OTA_BLOCK_LEN; i++) hash = hash * OTA_HASH_BASE + ota_base.data[i];
+        for(src = 0; ; src++){
+            slot = (hash * 2654435761u) >> (32 - OTA_TABLE_BITS);
+            if(table[slot] == OTA_NO_SRC) table[slot] = src;
+            if(src + TLM_OTA_BLOCK_LEN >= ota_base.len) break;
+            hash = (hash - ota_base.data[src] * top) * OTA_HASH_BASE + ota_base.data[src + TLM_OTA_BLOCK_LEN];
+        }
+    }
+
+    for(b = 0; b < ota_num_blocks; b++){
+        blk = &ota_blocks[b];
+        const uint8_t *data = &ota_new.data[b * TLM_OTA_BLOCK_LEN];
+
+        // Same offset first, most blocks that did not change did not move either
+        if((b * TLM_OTA_BLOCK_LEN + blk->len <= ota_base.len) && !memcmp(data, &ota_base.data[b * TLM_OTA_BLOCK_LEN], blk->len)){
+            blk->copy_src = b * TLM_OTA_BLOCK_LEN;
+            continue;
+        }
+        if(blk->len != TLM_OTA_BLOCK_LEN) continue;
+        hash = 0;
+        for(i = 0; i < TLM_OTA_BLOCK_LEN; i++) hash = hash * OTA_HASH_BASE + data[i];
+        src = table[(hash * 2654435761u) >> (32 - OTA_TABLE_BITS)];
+        if((src != OTA_NO_SRC) && !memcmp(data, &ota_base.data[src], TLM_OTA_BLOCK_LEN)){
+            blk->copy_src = src;
+        }
+    }
+    free(table);
+}
+
+
+// Encode_Blocks
+// Splits the new image into blocks and prepares their encodings
+// Returns 0 on success, -1 if out of memory
+static int Encode_Blocks(uint8_t raw_only){
+    uLongf deflate_len;
+    uint8_t *buf;
+    uint32_t copies = 0;
+    uint64_t deflated = 0;
+    uint32_t b;
+
+    ota_num_blocks = (ota_new.len + TLM_OTA_BLOCK_LEN - 1) / TLM_OTA_BLOCK_LEN;
+    ota_blocks = calloc(ota_num_blocks, sizeof(ota_block_t));
+    if(ota_blocks == NULL) return -1;
+
+    for(b = 0; b < ota_num_blocks; b++){
+        ota_blocks[b].len = ota_new.len - b * TLM_OTA_BLOCK_LEN;
+        if(ota_blocks[b].len > TLM_OTA_BLOCK_LEN) ota_blocks[b].len = TLM_OTA_BLOCK_LEN;
+        ota_blocks[b].copy_src = OTA_NO_SRC;
+        if(raw_only) continue;
+
+        deflate_len = compressBound(TLM_OTA_BLOCK_LEN);
+        buf = malloc(deflate_len);
+        if(buf == NULL) return -1;
+        if((compress2(buf, &deflate_len, &ota_new.data[b * TLM_OTA_BLOCK_LEN], ota_blocks[b].len, Z_BEST_COMPRESSION) == Z_OK)
+           && (deflate_len < ota_blocks[b].len)){
+            ota_blocks[b].deflate = buf;
+            ota_blocks[b].deflate_len = (uint16_t) deflate_len;
+            deflated += deflate_len;
+        }
+        else{
+            free(buf);
+            deflated += ota_blocks[b].len;
+        }
+    }
+    if(ota_base.data && !raw_only) Find_Copies();
+
+    for(b = 0; b < ota_num_blocks; b++){
+        copies += ota_blocks[b].copy_src != OTA_NO_SRC;
+    }
+    printf("%u bytes in %u blocks, %llu deflated, %u of them found in the base image\n",
+           ota_new.len, ota_num_blocks, (unsigned long long) deflated, copies);
+    return 0;
+}
+
+
+// Send_All
+// Blocking send of the whole buffer
+// Returns 0 on success, -1 if the connection failed
+static int Send_All(int sock, const void *buf, size_t len){
+    const uint8_t *p = buf;
+    ssize_t n;
+
+    while(len){
+        n = send(sock, p, len, MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+
+// Send_Frame
+// Returns 0 on success, -1 if the connection failed
+static int Send_Frame(int sock, uint8_t type, uint16_t unit_id, const void *head, uint16_t head_len, const void *data, uint16_t data_len){
+    uint8_t frame[sizeof(tlm_header_t) + TLM_MAX_PAYLOAD];
+    tlm_header_t header = {
+        .magic = TLM_MAGIC,
+        .version = TLM_VERSION,
+        .type = type,
+        .length = head_len + data_len,
+        .seq = ota_tx_seq++,
+        .unit_id = unit_id,
+        .tx_time_us = Now_us(),
+    };
+
+    memcpy(frame, &header, sizeof(header));
+    memcpy(&frame[sizeof(header)], head, head_len);
+    if(data_len) memcpy(&frame[sizeof(header) + head_len], data, data_len);
+    return Send_All(sock, frame, sizeof(header) + header.length);
+}
+
+
+// Send_Block
+// Sends one block as data frames in the best encoding the vehicle allows
+// Returns 0 on success, -1 if the connection failed
+static int Send_Block(int sock, uint16_t unit_id, uint32_t b, uint8_t encodings, uint8_t use_base, ota_stats_t *stats){
+    const ota_block_t *blk = &ota_blocks[b];
+    const uint8_t *enc = &ota_new.data[b * TLM_OTA_BLOCK_LEN];
+    uint16_t piece;
+    tlm_ota_data_t data = {
+        .block = b,
+        .encoding = TLM_OTA_ENC_RAW,
+        .enc_len = blk->len,
+        .offset = 0,
+        .src = 0,
+    };
+
+    if(use_base && (blk->copy_src != OTA_NO_SRC)){
+        data.encoding = TLM_OTA_ENC_COPY;
+        data.enc_len = 0;
+        data.src = blk->copy_src;
+    }
+    else if((encodings & (1 << TLM_OTA_ENC_DEFLATE)) && blk->deflate){
+        data.encoding = TLM_OTA_ENC_DEFLATE;
+        data.enc_len = blk->deflate_len;
+        enc = blk->deflate;
+    }
+    stats->blocks[data.encoding]++;
+
+    do{
+        piece = data.enc_len - data.offset;
+        if(piece > TLM_OTA_PIECE_MAX) piece = TLM_OTA_PIECE_MAX;
+        if(Send_Frame(sock, TLM_TYPE_OTA_DATA, unit_id, &data, sizeof(data), &enc[data.offset], piece) < 0) return -1;
+        stats->bytes += sizeof(tlm_header_t) + sizeof(data) + piece;
+        data.offset += piece;
+    } while(data.offset < data.enc_len);
+    return 0;
+}
+
+
+// Serve_Vehicle
+// Answers the query of one vehicle and then its block requests until it hangs up
+static void Serve_Vehicle(int sock){
+    static uint8_t rx[2 * (sizeof(tlm_header_t) + TLM_MAX_PAYLOAD)];
+    const tlm_header_t *header;
+    const uint8_t *payload;
+    tlm_ota_query_t query;
+    tlm_ota_info_t info = {0};
+    tlm_ota_req_t req;
+    ota_stats_t stats = {0};
+    uint32_t rx_len = 0;
+    uint32_t off;
+    uint32_t b;
+    uint16_t unit_id = 0;
+    uint8_t use_base = 0;
+    uint8_t queried = 0;
+    int64_t start_us = Now_us();
+    ssize_t n;
+
+    while(!ota_stop){
+        n = recv(sock, &rx[rx_len], sizeof(rx) - rx_len, 0);
+        if(n <= 0){
+            if((n < 0) && (errno == EINTR)) continue;
+            break;
+        }
+        rx_len += n;
+
+        for(off = 0; rx_len - off >= sizeof(tlm_header_t); off += sizeof(tlm_header_t) + header->length){
+            header = (const tlm_header_t *) &rx[off];
+            if((header->magic != TLM_MAGIC) || (header->version != TLM_VERSION) || (header->length > TLM_MAX_PAYLOAD)){
+                fprintf(stderr, "[sock=%d] bad frame header, closing\n", sock);
+                return;
+            }
+            if(rx_len - off < sizeof(tlm_header_t) + header->length) break;
+            payload = &rx[off + sizeof(tlm_header_t)];
+
+            if((header->type == TLM_TYPE_OTA_QUERY) && (header->length == sizeof(query))){
+                memcpy(&query, payload, sizeof(query));
+                unit_id = header->unit_id;
+                queried = 1;
+                use_base = ota_base.data && (query.encodings & (1 << TLM_OTA_ENC_COPY))
+                           && !memcmp(query.running_hash, ota_base.hash, TLM_OTA_HASH_LEN);
+                if(memcmp(query.running_hash, ota_new.hash, TLM_OTA_HASH_LEN)){
+                    info.image_len = ota_new.len;
+                    memcpy(info.image_hash, ota_new.hash, TLM_OTA_HASH_LEN);
+                }
+                printf("[sock=%d] unit %u runs %02x%02x%02x%02x, %s\n", sock, unit_id, query.running_hash[0],
+                       query.running_hash[1], query.running_hash[2], query.running_hash[3],
+                       info.image_len ? (use_base ? "sending delta" : "sending image") : "up to date");
+                if(Send_Frame(sock, TLM_TYPE_OTA_INFO, unit_id, &info, sizeof(info), NULL, 0) < 0) return;
+            }
+            else if(queried && (header->type == TLM_TYPE_OTA_REQ) && (header->length == sizeof(req)) && info.image_len){
+                memcpy(&req, payload, sizeof(req));
+                for(b = req.first_block; (b < ota_num_blocks) && (b < req.first_block + req.count); b++){
+                    if(Send_Block(sock, unit_id, b, query.encodings, use_base, &stats) < 0) return;
+                }
+            }
+        }
+        memmove(rx, &rx[off], rx_len - off);
+        rx_len -= off;
+    }
+
+    if(stats.blocks[0] + stats.blocks[1] + stats.blocks[2]){
+        printf("[sock=%d] unit %u: %u raw, %u deflate, %u copy blocks, %llu bytes sent for %u in %.1f s\n", sock, unit_id,
+               stats.blocks[TLM_OTA_ENC_RAW], stats.blocks[TLM_OTA_ENC_DEFLATE], stats.blocks[TLM_OTA_ENC_COPY],
+               (unsigned long long) stats.bytes, ota_new.len, (Now_us() - start_us) / 1e6);
+    }
+}
+
+
+// Usage
+static int Usage(const char *prog){
+    fprintf(stderr, "usage: %s -f new.bin [-B running.bin] [-p port] [-r]\n", prog);
+    return 2;
+}
+
+
+int main(int argc, char **argv){
+    const char *new_path = NULL;
+    const char *base_path = NULL;
+    uint16_t port = OTA_DEFAULT_PORT;
+    uint8_t raw_only = 0;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct sigaction stop_action = {
+        .sa_handler = On_Signal,
+    };
+    int listen_sock;
+    int sock;
+    int one = 1;
+    int opt;
+
+    while((opt = getopt(argc, argv, "f:B:p:r")) != -1){
+        switch(opt){
+        case 'f': new_path = optarg; break;
+        case 'B': base_path = optarg; break;
+        case 'p': port = (uint16_t) atoi(optarg); break;
+        case 'r': raw_only = 1; break;
+        default: return Usage(argv[0]);
+        }
+    }
+    if(new_path == NULL) return Usage(argv[0]);
+    if(Load_Image(new_path, &ota_new) < 0) return 1;
+    if(base_path && (Load_Image(base_path, &ota_base) < 0)) return 1;
+    if(Encode_Blocks(raw_only) < 0) return 1;
+
+    // No SA_RESTART, so a blocked accept or recv returns and sees ota_stop
+    sigaction(SIGINT, &stop_action, NULL);
+    sigaction(SIGTERM, &stop_action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    addr.sin_port = htons(port);
+    listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if((bind(listen_sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(listen_sock, 16) < 0)){
+        perror("bind/listen");
+        return 1;
+    }
+    printf("Serving %s on port %u\n", new_path, port);
+
+    while(!ota_stop){
+        sock = accept(listen_sock, NULL, NULL);
+        if(sock < 0) continue;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        Serve_Vehicle(sock);
+        close(sock);
+    }
+    close(listen_sock);
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*
+Host side replay of a recorded flight through the control step
+Reads the TLM_TYPE_REPLAY frames that ground_station serve -w saved,
+rebuilds the configuration, GPS snapshots and step inputs, runs them through
+Control_Step from main/control_step.c, and diffs the outputs against the
+ones the vehicle produced. Also times each step on the host
+
+Behaviour changes show up as output mismatches against the recording
+Two versions of the control code can be compared by dumping the replayed
+outputs of each with -d and diffing the dumps
+State mismatches mean the replayed state drifted from the vehicle's, the
+replay carries on with its own state so a changed law is followed through
+After a gap in the recording the replay restarts from the recorded state
+
+The firmware's compiler may fuse multiply-adds, so points right on a fence
+edge can come out differently on the host. Build with -ffp-contract=off
+
+Build:  gcc -O2 -Wall -ffp-contract=off -o replay tools/replay/replay.c main/control_step.c main/failsafe.c
+Usage:  replay [-u unit_id] [-d dump_file] [-r repeat] [-n max_diffs] replay_file
+
+Author:         James Sorber
+Contact:        jrsorber@ncsu.edu
+Created:        10/19/2026
+Modified:       -
+*/
+
+// Include Header Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../main/telemetry.h"
+#include "../../main/config.h"
+#include "../../main/gps.h"
+#include "../../main/failsafe.h"
+#include "../../main/control.h"
+
+#define REPLAY_DEFAULT_REPEAT   100         // Step runs per timing sample, a single step is below the clock resolution
+#define REPLAY_DEFAULT_DIFFS    20
+
+
+// Custom data types
+typedef struct Replay_Stats{
+    uint32_t steps;
+    uint32_t out_diffs;
+    uint32_t state_diffs;
+    uint32_t gaps;                          // Steps missing from the recording
+    uint32_t restarts;
+    uint32_t skipped;                       // Steps without a complete config before them
+    uint32_t configs;
+    uint64_t vehicle_step_us_sum;
+    uint32_t vehicle_step_us_max;
+} replay_stats_t;
+
+
+// Global to this file
+static laelaps_config_t replay_cfg;         // Active, fences built from it
+static laelaps_config_t replay_cfg_next;    // Being reassembled
+static uint32_t replay_cfg_next_version = 0;
+static uint32_t replay_cfg_fill = 0;        // Bytes of replay_cfg_next received in order
+static uint8_t replay_cfg_valid = 0;
+static float *replay_step_ns;
+static uint32_t replay_num_samples = 0;
+
+
+static int64_t Now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int Compare_Float(const void *a, const void *b){
+    float x = *(const float *) a;
+    float y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+
+// On_Config
+// Reassembles a configuration from its chunks, activates it once complete
+// Returns -1 if the recording was made with a different laelaps_config_t
+static int On_Config(const control_rec_config_t *rec, uint16_t len, replay_stats_t *stats){
+    uint16_t data_len = len - offsetof(control_rec_config_t, data);
+
+    if(rec->total != sizeof(laelaps_config_t)){
+        fprintf(stderr, "Recorded config is %u bytes, this build's is %zu. Replay with the matching config.h\n",
+                rec->total, sizeof(laelaps_config_t));
+        return -1;
+    }
+    if(rec->offset == 0){
+        replay_cfg_next_version = rec->version;
+        replay_cfg_fill = 0;
+    }
+    if((rec->version != replay_cfg_next_version) || (rec->offset != replay_cfg_fill)
+       || (rec->offset + data_len > sizeof(laelaps_config_t))){
+        return 0;                           // Out of order piece, wait for the resend
+    }
+    memcpy((uint8_t *) &replay_cfg_next + rec->offset, rec->data, data_len);
+    replay_cfg_fill += data_len;
+
+    if(replay_cfg_fill == sizeof(laelaps_config_t)){
+        if(replay_cfg_next.schema_version != CFG_SCHEMA_VERSION){
+            fprintf(stderr, "Recorded config schema %lu, this build's is %u\n",
+                    (unsigned long) replay_cfg_next.schema_version, CFG_SCHEMA_VERSION);
+            return -1;
+        }
+        replay_cfg = replay_cfg_next;
+        replay_cfg_valid = 1;
+        replay_cfg_fill = 0;
+        Failsafe_Build_Fences(&replay_cfg, 0);
+        stats->configs++;
+    }
+    return 0;
+}
+
+
+// Print_Outputs
+static void Print_Outputs(FILE *f, const char *name, const control_outputs_t *out){
+    uint8_t i;
+
+    fprintf(f, "%s failsafe 0x%02x servos", name, out->failsafe);
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        if(out->servo_mask & (1 << i)) fprintf(f, " %d", out->servo[i]);
+        else fprintf(f, " -");
+    }
+    fprintf(f, "\n");
+}
+
+
+// Outputs_Equal
+// Servo values only count for the channels that are driven
+static uint8_t Outputs_Equal(const control_outputs_t *a, const control_outputs_t *b){
+    uint8_t i;
+
+    if((a->failsafe != b->failsafe) || (a->servo_mask != b->servo_mask)) return 0;
+    for(i = 0; i < CFG_NUM_SERVOS; i++){
+        if((a->servo_mask & (1 << i)) && (a->servo[i] != b->servo[i])) return 0;
+    }
+    return 1;
+}
+
+
+// Replay
+// Runs every step of one unit through Control_Step
+// A unit_id of -1 picks the first unit in the recording
+// Returns 0 on success, -1 for a recording this build cannot replay
+static int Replay(const uint8_t *log, size_t log_len, int *unit_id, FILE *dump, uint32_t repeat, uint32_t max_diffs, replay_stats_t *stats){
+    const tlm_header_t *header;
+    const uint8_t *payload;
+    const control_rec_step_t *rec;
+    control_state_t state;
+    control_state_t scratch;
+    control_inputs_t in;
+    control_outputs_t out;
+    control_outputs_t vehicle_out;
+    uint32_t next_iteration = 0;
+    uint8_t have_state = 0;
+    size_t pos = 0;
+    uint32_t r;
+    int64_t start;
+
+    memset(&in, 0, sizeof(in));
+    while(pos + sizeof(tlm_header_t) <= log_len){
+        header = (const tlm_header_t *) (log + pos);
+        payload = log + pos + sizeof(tlm_header_t);
+        if((header->magic != TLM_MAGIC) || (pos + sizeof(tlm_header_t) + header->length > log_len)){
+            fprintf(stderr, "Corrupt frame at byte %zu\n", pos);
+            return -1;
+        }
+        pos += sizeof(tlm_header_t) + header->length;
+        if((header->type != TLM_TYPE_REPLAY) || (header->length == 0)) continue;
+        if(*unit_id < 0) *unit_id = header->unit_id;
+        if(header->unit_id != *unit_id) continue;
+
+        switch(payload[0]){
+        case CONTROL_REC_CONFIG:
+            if(header->length < offsetof(control_rec_config_t, data)) break;
+            if(On_Config((const control_rec_config_t *) payload, header->length, stats) < 0) return -1;
+        break;
+
+        case CONTROL_REC_GPS:
+            if(header->length != sizeof(control_rec_gps_t)) break;
+            in.gps = ((const control_rec_gps_t *) payload)->gps;
+        break;
+
+        case CONTROL_REC_STEP:
+            if(header->length != sizeof(control_rec_step_t)) break;
+            rec = (const control_rec_step_t *) payload;
+            if(!replay_cfg_valid || (rec->cfg_version != replay_cfg.version)){
+                stats->skipped++;
+                have_state = 0;
+                break;
+            }
+
+            // Iterations restart at 1 with the vehicle. Resync from the recording after a gap
+            if(have_state && (rec->iteration < next_iteration)){
+                stats->restarts++;
+                have_state = 0;
+            }
+            else if(have_state && (rec->iteration > next_iteration)){
+                stats->gaps += rec->iteration - next_iteration;
+                have_state = 0;
+            }
+            if(!have_state){
+                state = rec->state;
+                have_state = 1;
+            }
+            else if(memcmp(&state, &rec->state, sizeof(control_state_t)) != 0){
+                stats->state_diffs++;
+            }
+
+            in.now_us = rec->now_us;
+            in.link_down_us = rec->link_down_us;
+
+            start = Now_ns();
+            for(r = 1; r < repeat; r++){
+                scratch = state;
+                Control_Step(&replay_cfg, &scratch, &in, &out);
+            }
+            Control_Step(&replay_cfg, &state, &in, &out);
+            replay_step_ns[replay_num_samples++] = (float) (Now_ns() - start) / repeat;
+            next_iteration = rec->iteration + 1;
+
+            stats->steps++;
+            stats->vehicle_step_us_sum += rec->step_us;
+            if(rec->step_us > stats->vehicle_step_us_max) stats->vehicle_step_us_max = rec->step_us;
+            vehicle_out = rec->out;
+            if(!Outputs_Equal(&out, &vehicle_out)){
+                if(stats->out_diffs < max_diffs){
+                    printf("Step %lu at %lld us differs\n", (unsigned long) rec->iteration, (long long) rec->now_us);
+                    Print_Outputs(stdout, "  vehicle", &vehicle_out);
+                    Print_Outputs(stdout, "  replay ", &out);
+                }
+                stats->out_diffs++;
+            }
+            if(dump){
+                fprintf(dump, "%lu ", (unsigned long) rec->iteration);
+                Print_Outputs(dump, "", &out);
+            }
+        break;
+
+        default:
+        break;
+        }
+    }
+    return 0;
+}
+
+
+static int Usage(const char *prog){
+    fprintf(stderr, "usage: %s [-u unit_id] [-d dump_file] [-r repeat] [-n max_diffs] replay_file\n", prog);
+    return 2;
+}
+
+
+int main(int argc, char **argv){
+    replay_stats_t stats = {0};
+    int unit_id = -1;
+    const char *dump_name = NULL;
+    FILE *dump = NULL;
+    FILE *f;
+    uint8_t *log;
+    long log_len;
+    uint32_t repeat = REPLAY_DEFAULT_REPEAT;
+    uint32_t max_diffs = REPLAY_DEFAULT_DIFFS;
+    uint32_t n;
+    int opt;
+
+    while((opt = getopt(argc, argv, "u:d:r:n:")) != -1){
+        switch(opt){
+        case 'u': unit_id = atoi(optarg); break;
+        case 'd': dump_name = optarg; break;
+        case 'r': repeat = (uint32_t) atoi(optarg); break;
+        case 'n': max_diffs = (uint32_t) atoi(optarg); break;
+        default: return Usage(argv[0]);
+        }
+    }
+    if((optind != argc - 1) || (repeat == 0)) return Usage(argv[0]);
+
+    f = fopen(argv[optind], "rb");
+    if(f == NULL){
+        perror(argv[optind]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    log_len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    log = malloc(log_len > 0 ? log_len : 1);
+    if((log == NULL) || (fread(log, 1, log_len, f) != (size_t) log_len)){
+        fprintf(stderr, "Failed to read %s\n", argv[optind]);
+        return 1;
+    }
+    fclose(f);
+
+    // At most one step per record, sized from the smallest step frame
+    replay_step_ns = malloc((log_len / (sizeof(tlm_header_t) + sizeof(control_rec_step_t)) + 1) * sizeof(float));
+    if(dump_name){
+        dump = fopen(dump_name, "w");
+        if(dump == NULL){
+            perror(dump_name);
+            return 1;
+        }
+    }
+
+    if(Replay(log, (size_t) log_len, &unit_id, dump, repeat, max_diffs, &stats) < 0) return 1;
+    if(dump) fclose(dump);
+    if(stats.steps == 0){
+        fprintf(stderr, "No replayable steps in %s\n", argv[optind]);
+        return 1;
+    }
+
+    printf("Unit %d: %lu steps, %lu configs, %lu gaps, %lu restarts, %lu skipped without config\n", unit_id,
+           (unsigned long) stats.steps, (unsigned long) stats.configs, (unsigned long) stats.gaps,
+           (unsigned long) stats.restarts, (unsigned long) stats.skipped);
+    printf("%lu output mismatches, %lu state mismatches\n", (unsigned long) stats.out_diffs, (unsigned long) stats.state_diffs);
+    n = replay_num_samples;
+    qsort(replay_step_ns, n, sizeof(float), Compare_Float);
+    printf("Host step time     p50 %.1f  p99 %.1f  max %.1f ns\n",
+           replay_step_ns[n / 2], replay_step_ns[(uint32_t) ((uint64_t) n * 99 / 100)], replay_step_ns[n - 1]);
+    printf("Vehicle step time  mean %llu  max %lu us\n",
+           (unsigned long long) (stats.vehicle_step_us_sum / stats.steps), (unsigned long) stats.vehicle_step_us_max);
+    free(replay_step_ns);
+    free(log);
+    return (stats.out_diffs || stats.state_diffs) ? 3 : 0;
+}